@@ -7,6 +7,20 @@
 #include <fstream>
 #include <sstream>
 #include <iomanip>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <type_traits>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdexcept>
+#include <exception>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIGNAL_X86_KERNELS
+#include <immintrin.h>
+#endif
 
 // Image processing for decoding
 #define STB_IMAGE_IMPLEMENTATION
@@ -57,341 +71,5019 @@ string findLongestPalindrome(const string &s)
             R = i + P[i];
         }
 
-        if (P[i] > maxLen)
-        {
-            maxLen = P[i];
-            centerIndex = i;
-        }
+        if (P[i] > maxLen)
+        {
+            maxLen = P[i];
+            centerIndex = i;
+        }
+    }
+
+    int start = (centerIndex - maxLen) / 2;
+    return s.substr(start, maxLen);
+}
+
+// ==================== PACKED BITSTREAM ====================
+
+class BitStream
+{
+public:
+    BitStream() : bitLength(0) {}
+
+    size_t size() const { return bitLength; }
+    bool empty() const { return bitLength == 0; }
+    size_t wordCount() const { return words.size(); }
+
+    const uint64_t *data() const { return words.data(); }
+    uint64_t *data() { return words.data(); }
+
+    bool get(size_t i) const
+    {
+        return (words[i >> 6] >> (i & 63)) & 1;
+    }
+
+    void set(size_t i, bool bit)
+    {
+        uint64_t mask = (uint64_t)1 << (i & 63);
+        if (bit)
+            words[i >> 6] |= mask;
+        else
+            words[i >> 6] &= ~mask;
+    }
+
+    void reserve(size_t numBits)
+    {
+        words.reserve((numBits + 63) / 64);
+    }
+
+    void resize(size_t numBits)
+    {
+        words.resize((numBits + 63) / 64, 0);
+        bitLength = numBits;
+        clearTail();
+    }
+
+    void clear()
+    {
+        words.clear();
+        bitLength = 0;
+    }
+
+    void pushBit(bool bit)
+    {
+        if ((bitLength & 63) == 0)
+            words.push_back(0);
+        if (bit)
+            words.back() |= (uint64_t)1 << (bitLength & 63);
+        bitLength++;
+    }
+
+    // Appends the low `count` bits of value, least significant bit first.
+    void appendBits(uint64_t value, int count)
+    {
+        if (count <= 0)
+            return;
+        if (count < 64)
+            value &= ((uint64_t)1 << count) - 1;
+
+        int offset = bitLength & 63;
+        if (offset == 0)
+        {
+            words.push_back(value);
+        }
+        else
+        {
+            words.back() |= value << offset;
+            if (offset + count > 64)
+                words.push_back(value >> (64 - offset));
+        }
+        bitLength += count;
+    }
+
+    // Reads `count` (at most 64) bits starting at pos, least significant bit first.
+    uint64_t getBits(size_t pos, int count) const
+    {
+        size_t w = pos >> 6;
+        int offset = pos & 63;
+        uint64_t value = words[w] >> offset;
+        if (offset + count > 64)
+            value |= words[w + 1] << (64 - offset);
+        if (count < 64)
+            value &= ((uint64_t)1 << count) - 1;
+        return value;
+    }
+
+    // Appends a `count`-bit codeword most significant bit first, the order PCM emits samples in.
+    void appendCodeword(uint64_t code, int count)
+    {
+        uint64_t reversed = 0;
+        for (int i = 0; i < count; i++)
+        {
+            reversed = (reversed << 1) | ((code >> i) & 1);
+        }
+        appendBits(reversed, count);
+    }
+
+    void append(const BitStream &other)
+    {
+        size_t remaining = other.bitLength;
+        for (size_t w = 0; remaining > 0; w++)
+        {
+            int count = remaining < 64 ? (int)remaining : 64;
+            appendBits(other.words[w], count);
+            remaining -= count;
+        }
+    }
+
+    static BitStream fromString(const string &data)
+    {
+        BitStream bits;
+        bits.resize(data.size());
+        for (size_t i = 0; i < data.size(); i++)
+        {
+            if (data[i] == '1')
+                bits.words[i >> 6] |= (uint64_t)1 << (i & 63);
+        }
+        return bits;
+    }
+
+    string toString() const
+    {
+        string data(bitLength, '0');
+        for (size_t i = 0; i < bitLength; i++)
+        {
+            if (get(i))
+                data[i] = '1';
+        }
+        return data;
+    }
+
+private:
+    vector<uint64_t> words;
+    size_t bitLength;
+
+    void clearTail()
+    {
+        if (bitLength & 63)
+            words.back() &= ((uint64_t)1 << (bitLength & 63)) - 1;
+    }
+};
+
+// Line-code levels are only ever -1, 0 or +1, so one signed byte per sample is enough.
+typedef vector<int8_t> Signal;
+
+// ==================== SIMD LEVEL KERNELS ====================
+
+// Byte-indexed tables for the Manchester codes, generated at compile time.
+struct LineCodeTables
+{
+    int8_t manchester[256][16]; // the 16 Manchester levels of a byte, LSB first
+    uint8_t prefixParity[256];  // bit i = XOR of bits 0..i
+    uint8_t pairBits[256];      // bit i = bits 2i and 2i+1 both set
+    uint64_t byteSpread[256];   // bit i -> byte i set to 1, little-endian
+};
+
+constexpr LineCodeTables makeLineCodeTables()
+{
+    LineCodeTables t{};
+    for (unsigned b = 0; b < 256; b++)
+    {
+        unsigned parity = 0;
+        for (unsigned i = 0; i < 8; i++)
+        {
+            int8_t level = ((b >> i) & 1) ? 1 : -1;
+            t.manchester[b][2 * i] = -level;
+            t.manchester[b][2 * i + 1] = level;
+            parity ^= (b >> i) & 1;
+            t.prefixParity[b] |= parity << i;
+        }
+        for (unsigned i = 0; i < 4; i++)
+        {
+            if (((b >> (2 * i)) & 3) == 3)
+                t.pairBits[b] |= 1 << i;
+        }
+        for (unsigned i = 0; i < 8; i++)
+        {
+            t.byteSpread[b] |= (uint64_t)((b >> i) & 1) << (8 * i);
+        }
+    }
+    return t;
+}
+
+// Expands packed bits into line-code levels. The AVX2 and SSE2 paths turn 32 or 16
+// bits into a byte mask per iteration; whatever they leave over goes through the scalar loop.
+class LevelKernels
+{
+public:
+    static uint64_t prefixXor(uint64_t x)
+    {
+        x ^= x << 1;
+        x ^= x << 2;
+        x ^= x << 4;
+        x ^= x << 8;
+        x ^= x << 16;
+        x ^= x << 32;
+        return x;
+    }
+
+    static int countTrailingZeros(uint64_t x)
+    {
+#ifdef __GNUC__
+        return __builtin_ctzll(x);
+#else
+        int n = 0;
+        while (!(x & 1))
+        {
+            x >>= 1;
+            n++;
+        }
+        return n;
+#endif
+    }
+
+    static int popCount(uint64_t x)
+    {
+#ifdef __GNUC__
+        return __builtin_popcountll(x);
+#else
+        int n = 0;
+        for (; x; x &= x - 1)
+        {
+            n++;
+        }
+        return n;
+#endif
+    }
+
+    static int countLeadingZeros(uint64_t x)
+    {
+#ifdef __GNUC__
+        return __builtin_clzll(x);
+#else
+        int n = 0;
+        while (!(x >> 63))
+        {
+            x <<= 1;
+            n++;
+        }
+        return n;
+#endif
+    }
+
+    // 1 -> +1, 0 -> -1
+    static void expandNRZ(const uint64_t *words, size_t numBits, int8_t *out)
+    {
+        size_t done = 0;
+#ifdef SIGNAL_X86_KERNELS
+        if (hasAVX2())
+            done = expandNRZAVX2(words, numBits / 64, out);
+        else if (hasSSE2())
+            done = expandNRZSSE2(words, numBits / 64, out);
+#endif
+        for (size_t i = done; i < numBits; i++)
+        {
+            out[i] = bitAt(words, i) ? 1 : -1;
+        }
+    }
+
+    // 1 -> (-1, +1), 0 -> (+1, -1)
+    static void expandManchester(const uint64_t *words, size_t numBits, int8_t *out)
+    {
+        size_t done = 0;
+#ifdef SIGNAL_X86_KERNELS
+        if (hasAVX2())
+            done = expandManchesterAVX2(words, numBits / 64, out);
+        else if (hasSSE2())
+            done = expandManchesterSSE2(words, numBits / 64, out);
+#endif
+        const LineCodeTables &t = tables();
+        for (; done + 8 <= numBits; done += 8)
+        {
+            memcpy(out + 2 * done, t.manchester[byteAt(words, done / 8)], 16);
+        }
+        for (size_t i = done; i < numBits; i++)
+        {
+            int8_t level = bitAt(words, i) ? 1 : -1;
+            out[2 * i] = -level;
+            out[2 * i + 1] = level;
+        }
+    }
+
+    // 1 -> '1', 0 -> '0'
+    static void expandChars(const uint64_t *words, size_t numBits, char *out)
+    {
+        size_t done = 0;
+#ifdef SIGNAL_X86_KERNELS
+        if (hasAVX2())
+            done = expandCharsAVX2(words, numBits / 64, out);
+        else if (hasSSE2())
+            done = expandCharsSSE2(words, numBits / 64, out);
+#endif
+        for (size_t i = done; i < numBits; i++)
+        {
+            out[i] = bitAt(words, i) ? '1' : '0';
+        }
+    }
+
+    // 0 -> 0, 1 -> alternating -1/+1, starting at -1. The polarity of each mark is the
+    // running parity of the ones seen so far, so it comes from a prefix XOR per word.
+    static void expandAMI(const uint64_t *words, size_t numBits, int8_t *out)
+    {
+        uint64_t parity = 0;
+        expandAMI(words, numBits, out, parity);
+    }
+
+    // Streaming form: parity is 0 or all ones and carries the running parity of the
+    // ones across calls.
+    static void expandAMI(const uint64_t *words, size_t numBits, int8_t *out, uint64_t &parity)
+    {
+        size_t done = 0;
+#ifdef SIGNAL_X86_KERNELS
+        if (hasAVX2())
+            done = expandAMIAVX2(words, numBits / 64, out, parity);
+        else if (hasSSE2())
+            done = expandAMISSE2(words, numBits / 64, out, parity);
+#endif
+        for (size_t first = done; first < numBits; first += 64)
+        {
+            size_t n = min((size_t)64, numBits - first);
+            uint64_t x = words[first / 64];
+            if (n < 64)
+                x &= ((uint64_t)1 << n) - 1;
+            uint64_t odd = prefixXor(x) ^ parity;
+            for (size_t i = 0; i < n; i++)
+            {
+                if (!((x >> i) & 1))
+                    out[first + i] = 0;
+                else
+                    out[first + i] = ((odd >> i) & 1) ? -1 : 1;
+            }
+            parity = 0 - (odd >> 63);
+        }
+    }
+
+    // MLT-3 cycles 0, +1, 0, -1 on every one, so the level follows the count of ones
+    // mod 4: its low bit is the prefix XOR and its high bit flips on each one that
+    // arrives while the count is odd. count carries the ones seen mod 4 across calls.
+    static void expandMLT3(const uint64_t *words, size_t numBits, int8_t *out, uint64_t &count)
+    {
+        for (size_t first = 0; first < numBits; first += 64)
+        {
+            size_t n = min((size_t)64, numBits - first);
+            uint64_t x = words[first / 64];
+            if (n < 64)
+                x &= ((uint64_t)1 << n) - 1;
+            uint64_t odd = prefixXor(x) ^ (0 - (count & 1));
+            uint64_t high = prefixXor(x & ~odd) ^ (0 - ((count >> 1) & 1));
+            uint64_t negative = odd & high;
+            const LineCodeTables &t = tables();
+            size_t i = 0;
+            for (; i + 8 <= n; i += 8)
+            {
+                // 1 ^ 0xFE = -1, so a spread negative byte flips a +1 to -1.
+                uint64_t levels = t.byteSpread[(odd >> i) & 0xFF] ^ (t.byteSpread[(negative >> i) & 0xFF] * 0xFE);
+                memcpy(out + first + i, &levels, 8);
+            }
+            for (; i < n; i++)
+            {
+                out[first + i] = (int8_t)((odd >> i) & 1) - (int8_t)(2 * ((negative >> i) & 1));
+            }
+            count = (count + popCount(x)) & 3;
+        }
+    }
+
+    // Parity of all bits in a run of words, as 0 or all ones.
+    static uint64_t parityOf(const uint64_t *words, size_t numWords)
+    {
+        uint64_t x = 0;
+        for (size_t w = 0; w < numWords; w++)
+        {
+            x ^= words[w];
+        }
+        x ^= x >> 32;
+        x ^= x >> 16;
+        x ^= x >> 8;
+        x ^= x >> 4;
+        x ^= x >> 2;
+        x ^= x >> 1;
+        return 0 - (x & 1);
+    }
+
+    // Inclusive prefix XOR of a run of words; parity is 0 or all ones and carries the
+    // running parity in and out. PCLMUL does a word in one multiply by all ones.
+    static uint64_t prefixXorWords(const uint64_t *in, size_t numWords, uint64_t *out, uint64_t parity)
+    {
+#ifdef SIGNAL_X86_KERNELS
+        if (hasPCLMUL())
+            return prefixXorWordsCLMUL(in, numWords, out, parity);
+#endif
+        for (size_t w = 0; w < numWords; w++)
+        {
+            out[w] = prefixXor(in[w]) ^ parity;
+            parity = 0 - (out[w] >> 63);
+        }
+        return parity;
+    }
+
+    // NRZ-I level is +1 exactly when an odd number of ones has been seen, so it is the
+    // NRZ expansion of the prefix XOR.
+    static void expandNRZI(const uint64_t *words, size_t numBits, int8_t *out)
+    {
+        uint64_t parity = 0;
+        expandNRZI(words, numBits, out, parity);
+    }
+
+    static void expandNRZI(const uint64_t *words, size_t numBits, int8_t *out, uint64_t &parity)
+    {
+        uint64_t block[blockWords];
+        for (size_t first = 0; first < numBits; first += blockWords * 64)
+        {
+            size_t count = min(blockWords * 64, numBits - first);
+            parity = prefixXorWords(words + first / 64, (count + 63) / 64, block, parity);
+            expandNRZ(block, count, out + first);
+        }
+    }
+
+    // Differential Manchester starts each bit at +1 exactly when the prefix XOR is odd,
+    // which is Manchester of the complemented prefix XOR.
+    static void expandDifferentialManchester(const uint64_t *words, size_t numBits, int8_t *out)
+    {
+        uint64_t parity = 0;
+        expandDifferentialManchester(words, numBits, out, parity);
+    }
+
+    static void expandDifferentialManchester(const uint64_t *words, size_t numBits, int8_t *out, uint64_t &parity)
+    {
+        if (!hasVectorUnit())
+        {
+            expandDifferentialManchesterTable(words, numBits, out, parity);
+            return;
+        }
+
+        uint64_t block[blockWords];
+        for (size_t first = 0; first < numBits; first += blockWords * 64)
+        {
+            size_t count = min(blockWords * 64, numBits - first);
+            size_t numWords = (count + 63) / 64;
+            parity = prefixXorWords(words + first / 64, numWords, block, parity);
+            for (size_t w = 0; w < numWords; w++)
+            {
+                block[w] = ~block[w];
+            }
+            expandManchester(block, count, out + 2 * first);
+        }
+    }
+
+    // Packs (level > 0) and (level == 0) masks, 64 samples per word. Together they
+    // tell the three levels apart, so comparing masks is the same as comparing levels.
+    static void packLevels(const int8_t *signal, size_t n, uint64_t *positive, uint64_t *zero)
+    {
+        size_t done = 0;
+#ifdef SIGNAL_X86_KERNELS
+        if (hasAVX2())
+            done = packLevelsAVX2(signal, n / 64, positive, zero);
+        else if (hasSSE2())
+            done = packLevelsSSE2(signal, n / 64, positive, zero);
+#endif
+        if (done < n)
+        {
+            for (size_t w = done / 64; w < (n + 63) / 64; w++)
+            {
+                positive[w] = 0;
+                zero[w] = 0;
+            }
+            for (size_t i = done; i < n; i++)
+            {
+                positive[i / 64] |= (uint64_t)(signal[i] > 0) << (i & 63);
+                zero[i / 64] |= (uint64_t)(signal[i] == 0) << (i & 63);
+            }
+        }
+    }
+
+    // Calls mark(i) for every nonzero sample in order. Positions come from a packed
+    // nonzero mask walked with count-trailing-zeros, so runs of zeros cost nothing.
+    template <class Mark>
+    static void forEachNonzero(const int8_t *signal, size_t n, Mark mark)
+    {
+        uint64_t positive[blockWords], zero[blockWords];
+        for (size_t first = 0; first < n; first += blockWords * 64)
+        {
+            size_t count = min(blockWords * 64, n - first);
+            size_t numWords = (count + 63) / 64;
+            packLevels(signal + first, count, positive, zero);
+            for (size_t w = 0; w < numWords; w++)
+            {
+                uint64_t nonzero = ~zero[w];
+                if (w == numWords - 1 && (count & 63))
+                    nonzero &= ((uint64_t)1 << (count & 63)) - 1;
+                while (nonzero)
+                {
+                    mark(first + w * 64 + countTrailingZeros(nonzero));
+                    nonzero &= nonzero - 1;
+                }
+            }
+        }
+    }
+
+    // NRZ-I decode: a one wherever the level differs from the previous one. prevLevel
+    // starts at -1 and is left at the last sample for the next call.
+    static void packNRZITransitions(const int8_t *signal, size_t n, uint64_t *bits, int8_t &prevLevel)
+    {
+        uint64_t positive[blockWords], zero[blockWords];
+        uint64_t positiveCarry = prevLevel > 0, zeroCarry = prevLevel == 0;
+        for (size_t first = 0; first < n; first += blockWords * 64)
+        {
+            size_t count = min(blockWords * 64, n - first);
+            packLevels(signal + first, count, positive, zero);
+            for (size_t w = 0; w < (count + 63) / 64; w++)
+            {
+                bits[first / 64 + w] = (positive[w] ^ ((positive[w] << 1) | positiveCarry)) |
+                                       (zero[w] ^ ((zero[w] << 1) | zeroCarry));
+                positiveCarry = positive[w] >> 63;
+                zeroCarry = zero[w] >> 63;
+            }
+        }
+        clearTail(bits, n);
+        if (n > 0)
+            prevLevel = signal[n - 1];
+    }
+
+    // Differential Manchester decode: a one wherever a bit starts at the level the
+    // previous bit ended on. prevEndLevel starts at +1.
+    static void packDifferentialManchester(const int8_t *signal, size_t numBits, uint64_t *bits, int8_t &prevEndLevel)
+    {
+        if (!hasVectorUnit())
+        {
+            packDifferentialManchesterTable(signal, numBits, bits, prevEndLevel);
+            return;
+        }
+
+        uint64_t positive[2 * blockWords], zero[2 * blockWords];
+        uint64_t positiveCarry = prevEndLevel > 0, zeroCarry = prevEndLevel == 0;
+        for (size_t first = 0; first < numBits; first += blockWords * 64)
+        {
+            size_t count = min(blockWords * 64, numBits - first);
+            size_t numWords = (count + 63) / 64;
+            positive[2 * numWords - 1] = 0;
+            zero[2 * numWords - 1] = 0;
+            packLevels(signal + 2 * first, 2 * count, positive, zero);
+            for (size_t w = 0; w < numWords; w++)
+            {
+                uint64_t startPositive = evenBits(positive[2 * w]) | (evenBits(positive[2 * w + 1]) << 32);
+                uint64_t endPositive = evenBits(positive[2 * w] >> 1) | (evenBits(positive[2 * w + 1] >> 1) << 32);
+                uint64_t startZero = evenBits(zero[2 * w]) | (evenBits(zero[2 * w + 1]) << 32);
+                uint64_t endZero = evenBits(zero[2 * w] >> 1) | (evenBits(zero[2 * w + 1] >> 1) << 32);
+                bits[first / 64 + w] = ~((startPositive ^ ((endPositive << 1) | positiveCarry)) |
+                                         (startZero ^ ((endZero << 1) | zeroCarry)));
+                positiveCarry = endPositive >> 63;
+                zeroCarry = endZero >> 63;
+            }
+        }
+        clearTail(bits, numBits);
+        if (numBits > 0)
+            prevEndLevel = signal[2 * numBits - 1];
+    }
+
+    // Manchester decode: a one for each (-1, +1) pair. Eight samples at a time are
+    // reduced to a byte of per-sample tests and a table turns that into four bits.
+    static void packManchester(const int8_t *signal, size_t numBits, uint64_t *bits)
+    {
+        if (numBits == 0)
+            return;
+        const LineCodeTables &t = tables();
+        memset(bits, 0, (numBits + 63) / 64 * sizeof(uint64_t));
+        size_t i = 0;
+        for (; i + 4 <= numBits; i += 4)
+        {
+            const int8_t *pair = signal + 2 * i;
+            unsigned index = (pair[0] == -1) | (pair[1] == 1) << 1 | (pair[2] == -1) << 2 | (pair[3] == 1) << 3 |
+                             (pair[4] == -1) << 4 | (pair[5] == 1) << 5 | (pair[6] == -1) << 6 | (pair[7] == 1) << 7;
+            bits[i / 64] |= (uint64_t)t.pairBits[index] << (i & 63);
+        }
+        for (; i < numBits; i++)
+        {
+            bits[i / 64] |= (uint64_t)(signal[2 * i] == -1 && signal[2 * i + 1] == 1) << (i & 63);
+        }
+    }
+
+    // B8ZS decode: the pulses, less the four of every 000VB0VB substitution. The pattern
+    // carries a violation between its two -V pulses that AMI data never produces, so it
+    // is matched on the level masks alone, one 64-sample word at a time.
+    static void packB8ZS(const int8_t *signal, size_t n, uint64_t *bits)
+    {
+        // Up to blockWords + 1 packed words, then a zero word for the shifted reads past them.
+        uint64_t positive[blockWords + 2], zero[blockWords + 2], nonzero[blockWords + 2];
+        uint64_t clearCarry = 0;
+        for (size_t first = 0; first < n; first += blockWords * 64)
+        {
+            size_t count = min(blockWords * 64, n - first);
+            size_t numWords = (count + 63) / 64;
+            // One word of lookahead so patterns that cross into the next block are seen.
+            size_t packed = min(count + 64, n - first);
+            size_t packedWords = (packed + 63) / 64;
+            packLevels(signal + first, packed, positive, zero);
+            for (size_t w = 0; w < packedWords; w++)
+            {
+                nonzero[w] = ~zero[w];
+            }
+            clearTail(nonzero, packed);
+            positive[packedWords] = zero[packedWords] = nonzero[packedWords] = 0;
+
+            for (size_t w = 0; w < numWords; w++)
+            {
+                auto at = [w](const uint64_t *mask, int k)
+                {
+                    return k ? (mask[w] >> k) | (mask[w + 1] << (64 - k)) : mask[w];
+                };
+                uint64_t starts = at(zero, 0) & at(zero, 1) & at(zero, 2) & at(nonzero, 3) & at(nonzero, 4) &
+                                  at(zero, 5) & at(nonzero, 6) & at(nonzero, 7) &
+                                  ~(at(positive, 3) ^ at(positive, 7)) & ~(at(positive, 4) ^ at(positive, 6)) &
+                                  (at(positive, 3) ^ at(positive, 4));
+                uint64_t substituted = (starts << 3) | (starts << 4) | (starts << 6) | (starts << 7) | clearCarry;
+                clearCarry = (starts >> 61) | (starts >> 60) | (starts >> 58) | (starts >> 57);
+                bits[first / 64 + w] = nonzero[w] & ~substituted;
+            }
+        }
+    }
+
+    // HDB3 decode: the pulses, less every violation (a pulse of the same polarity as the
+    // pulse before it) and the B of each B00V. A violation always follows two zeros, so
+    // only pulses in that position are checked against the previous pulse. lastPulse
+    // starts at +1 and is left at the polarity of the last pulse.
+    static void packHDB3(const int8_t *signal, size_t n, uint64_t *bits, int8_t &lastPulse)
+    {
+        uint64_t positive[blockWords], zero[blockWords];
+        // Samples before the signal count as zeros.
+        uint64_t prevZero = ~(uint64_t)0;
+        for (size_t first = 0; first < n; first += blockWords * 64)
+        {
+            size_t count = min(blockWords * 64, n - first);
+            size_t numWords = (count + 63) / 64;
+            packLevels(signal + first, count, positive, zero);
+            for (size_t w = 0; w < numWords; w++)
+            {
+                size_t base = first + w * 64;
+                uint64_t nonzero = ~zero[w];
+                if (w == numWords - 1 && (count & 63))
+                    nonzero &= ((uint64_t)1 << (count & 63)) - 1;
+                uint64_t zeroBefore1 = (zero[w] << 1) | (prevZero >> 63);
+                uint64_t zeroBefore2 = (zero[w] << 2) | (prevZero >> 62);
+                uint64_t pulseBefore3 = ~((zero[w] << 3) | (prevZero >> 61));
+                uint64_t candidates = nonzero & zeroBefore1 & zeroBefore2;
+                uint64_t word = nonzero;
+                while (candidates)
+                {
+                    int v = countTrailingZeros(candidates);
+                    candidates &= candidates - 1;
+                    uint64_t before = nonzero & (((uint64_t)1 << v) - 1);
+                    bool prevPositive = before ? (positive[w] >> (63 - countLeadingZeros(before))) & 1 : lastPulse > 0;
+                    if (((positive[w] >> v) & 1) != prevPositive)
+                        continue;
+                    word &= ~((uint64_t)1 << v);
+                    if ((pulseBefore3 >> v) & 1)
+                    {
+                        size_t b = base + v - 3;
+                        if (v >= 3)
+                            word &= ~((uint64_t)1 << (v - 3));
+                        else
+                            bits[b / 64] &= ~((uint64_t)1 << (b & 63));
+                    }
+                }
+                bits[base / 64] = word;
+                if (nonzero)
+                    lastPulse = ((positive[w] >> (63 - countLeadingZeros(nonzero))) & 1) ? 1 : -1;
+                prevZero = zero[w];
+            }
+        }
+    }
+
+    // Sends every kernel down its portable fallback, as on a build without a vector
+    // unit, so the scalar paths can be checked on x86 too.
+    static void forceScalar(bool force)
+    {
+        scalarOnly() = force;
+    }
+
+private:
+    static const size_t blockWords = 64;
+
+    static const LineCodeTables &tables()
+    {
+        static constexpr LineCodeTables t = makeLineCodeTables();
+        return t;
+    }
+
+    static unsigned byteAt(const uint64_t *words, size_t k)
+    {
+        return (words[k / 8] >> (8 * (k & 7))) & 0xFF;
+    }
+
+    // Portable Differential Manchester: each byte's prefix parity, adjusted by the one
+    // carried bit, selects a Manchester table entry.
+    static void expandDifferentialManchesterTable(const uint64_t *words, size_t numBits, int8_t *out, uint64_t &parity)
+    {
+        const LineCodeTables &t = tables();
+        unsigned carry = parity & 0xFF;
+        size_t i = 0;
+        for (; i + 8 <= numBits; i += 8)
+        {
+            unsigned odd = t.prefixParity[byteAt(words, i / 8)] ^ carry;
+            memcpy(out + 2 * i, t.manchester[~odd & 0xFF], 16);
+            carry = (odd & 0x80) ? 0xFF : 0;
+        }
+        for (; i < numBits; i++)
+        {
+            carry ^= bitAt(words, i) ? 0xFF : 0;
+            int8_t level = carry ? 1 : -1;
+            out[2 * i] = level;
+            out[2 * i + 1] = -level;
+        }
+        parity = carry ? ~(uint64_t)0 : 0;
+    }
+
+    static void packDifferentialManchesterTable(const int8_t *signal, size_t numBits, uint64_t *bits, int8_t &prevEndLevel)
+    {
+        if (numBits == 0)
+            return;
+        const LineCodeTables &t = tables();
+        memset(bits, 0, (numBits + 63) / 64 * sizeof(uint64_t));
+        size_t i = 0;
+        for (; i + 4 <= numBits; i += 4)
+        {
+            const int8_t *pair = signal + 2 * i;
+            unsigned index = 0xAA | (pair[0] == prevEndLevel) | (pair[2] == pair[1]) << 2 |
+                             (pair[4] == pair[3]) << 4 | (pair[6] == pair[5]) << 6;
+            bits[i / 64] |= (uint64_t)t.pairBits[index] << (i & 63);
+            prevEndLevel = pair[7];
+        }
+        for (; i < numBits; i++)
+        {
+            bits[i / 64] |= (uint64_t)(signal[2 * i] == prevEndLevel) << (i & 63);
+            prevEndLevel = signal[2 * i + 1];
+        }
+    }
+
+    static void clearTail(uint64_t *words, size_t numBits)
+    {
+        if (numBits & 63)
+            words[numBits / 64] &= ((uint64_t)1 << (numBits & 63)) - 1;
+    }
+
+    // Gathers bits 0, 2, 4, ... 62 into the low 32 bits.
+    static uint64_t evenBits(uint64_t x)
+    {
+        x &= 0x5555555555555555ULL;
+        x = (x | (x >> 1)) & 0x3333333333333333ULL;
+        x = (x | (x >> 2)) & 0x0F0F0F0F0F0F0F0FULL;
+        x = (x | (x >> 4)) & 0x00FF00FF00FF00FFULL;
+        x = (x | (x >> 8)) & 0x0000FFFF0000FFFFULL;
+        x = (x | (x >> 16)) & 0x00000000FFFFFFFFULL;
+        return x;
+    }
+
+    static bool bitAt(const uint64_t *words, size_t i)
+    {
+        return (words[i >> 6] >> (i & 63)) & 1;
+    }
+
+    friend class SampleKernels;
+    friend class ImaAdpcm;
+    friend class SourceKernels;
+    friend class PulseShaper;
+
+    static bool &scalarOnly()
+    {
+        static bool forced = false;
+        return forced;
+    }
+
+    static bool hasVectorUnit()
+    {
+#ifdef SIGNAL_X86_KERNELS
+        return hasAVX2() || hasSSE2();
+#else
+        return false;
+#endif
+    }
+
+#ifdef SIGNAL_X86_KERNELS
+    static bool hasAVX2()
+    {
+        static const bool supported = __builtin_cpu_supports("avx2");
+        return supported && !scalarOnly();
+    }
+
+    static bool hasSSE2()
+    {
+        static const bool supported = __builtin_cpu_supports("sse2");
+        return supported && !scalarOnly();
+    }
+
+    static bool hasPCLMUL()
+    {
+        static const bool supported = __builtin_cpu_supports("pclmul");
+        return supported && !scalarOnly();
+    }
+
+    __attribute__((target("pclmul,sse2"))) static uint64_t prefixXorWordsCLMUL(const uint64_t *in, size_t numWords, uint64_t *out, uint64_t parity)
+    {
+        const __m128i ones = _mm_set1_epi64x(-1);
+        for (size_t w = 0; w < numWords; w++)
+        {
+            __m128i x = _mm_loadl_epi64((const __m128i *)(in + w));
+            _mm_storel_epi64((__m128i *)(out + w), _mm_clmulepi64_si128(x, ones, 0x00));
+            out[w] ^= parity;
+            parity = 0 - (out[w] >> 63);
+        }
+        return parity;
+    }
+
+    __attribute__((target("avx2"))) static size_t packLevelsAVX2(const int8_t *signal, size_t numWords, uint64_t *positive, uint64_t *zero)
+    {
+        const __m256i none = _mm256_setzero_si256();
+        for (size_t w = 0; w < numWords; w++)
+        {
+            __m256i lo = _mm256_loadu_si256((const __m256i *)(signal + w * 64));
+            __m256i hi = _mm256_loadu_si256((const __m256i *)(signal + w * 64 + 32));
+            positive[w] = (uint32_t)_mm256_movemask_epi8(_mm256_cmpgt_epi8(lo, none)) |
+                          ((uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpgt_epi8(hi, none)) << 32);
+            zero[w] = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, none)) |
+                      ((uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, none)) << 32);
+        }
+        return numWords * 64;
+    }
+
+    __attribute__((target("sse2"))) static size_t packLevelsSSE2(const int8_t *signal, size_t numWords, uint64_t *positive, uint64_t *zero)
+    {
+        const __m128i none = _mm_setzero_si128();
+        for (size_t w = 0; w < numWords; w++)
+        {
+            uint64_t pos = 0, zer = 0;
+            for (int quarter = 0; quarter < 4; quarter++)
+            {
+                __m128i v = _mm_loadu_si128((const __m128i *)(signal + w * 64 + quarter * 16));
+                pos |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpgt_epi8(v, none)) << (16 * quarter);
+                zer |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, none)) << (16 * quarter);
+            }
+            positive[w] = pos;
+            zero[w] = zer;
+        }
+        return numWords * 64;
+    }
+
+    // 0xFF in byte j when bit j is set
+    __attribute__((target("avx2"))) static __m256i bitMaskAVX2(uint32_t bits)
+    {
+        const __m256i spread = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+                                                2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+        const __m256i select = _mm256_set1_epi64x((long long)0x8040201008040201ULL);
+        __m256i v = _mm256_shuffle_epi8(_mm256_set1_epi32((int)bits), spread);
+        return _mm256_cmpeq_epi8(_mm256_and_si256(v, select), select);
+    }
+
+    __attribute__((target("sse2"))) static __m128i bitMaskSSE2(uint16_t bits)
+    {
+        const __m128i select = _mm_set1_epi64x((long long)0x8040201008040201ULL);
+        // b0 b1 b0 b1 ... -> b0 x8, b1 x8
+        __m128i v = _mm_set1_epi16((short)bits);
+        v = _mm_unpacklo_epi8(v, v);
+        v = _mm_unpacklo_epi16(v, v);
+        v = _mm_unpacklo_epi32(v, v);
+        return _mm_cmpeq_epi8(_mm_and_si128(v, select), select);
+    }
+
+    __attribute__((target("avx2"))) static size_t expandNRZAVX2(const uint64_t *words, size_t numWords, int8_t *out)
+    {
+        const __m256i one = _mm256_set1_epi8(1);
+        const __m256i two = _mm256_set1_epi8(2);
+        for (size_t w = 0; w < numWords; w++)
+        {
+            for (int half = 0; half < 2; half++)
+            {
+                __m256i set = bitMaskAVX2((uint32_t)(words[w] >> (32 * half)));
+                __m256i level = _mm256_sub_epi8(_mm256_and_si256(set, two), one);
+                _mm256_storeu_si256((__m256i *)(out + w * 64 + half * 32), level);
+            }
+        }
+        return numWords * 64;
+    }
+
+    __attribute__((target("sse2"))) static size_t expandNRZSSE2(const uint64_t *words, size_t numWords, int8_t *out)
+    {
+        const __m128i one = _mm_set1_epi8(1);
+        const __m128i two = _mm_set1_epi8(2);
+        for (size_t w = 0; w < numWords; w++)
+        {
+            for (int quarter = 0; quarter < 4; quarter++)
+            {
+                __m128i set = bitMaskSSE2((uint16_t)(words[w] >> (16 * quarter)));
+                __m128i level = _mm_sub_epi8(_mm_and_si128(set, two), one);
+                _mm_storeu_si128((__m128i *)(out + w * 64 + quarter * 16), level);
+            }
+        }
+        return numWords * 64;
+    }
+
+    __attribute__((target("avx2"))) static size_t expandCharsAVX2(const uint64_t *words, size_t numWords, char *out)
+    {
+        const __m256i zeroChar = _mm256_set1_epi8('0');
+        for (size_t w = 0; w < numWords; w++)
+        {
+            for (int half = 0; half < 2; half++)
+            {
+                __m256i set = bitMaskAVX2((uint32_t)(words[w] >> (32 * half)));
+                _mm256_storeu_si256((__m256i *)(out + w * 64 + half * 32), _mm256_sub_epi8(zeroChar, set));
+            }
+        }
+        return numWords * 64;
+    }
+
+    __attribute__((target("sse2"))) static size_t expandCharsSSE2(const uint64_t *words, size_t numWords, char *out)
+    {
+        const __m128i zeroChar = _mm_set1_epi8('0');
+        for (size_t w = 0; w < numWords; w++)
+        {
+            for (int quarter = 0; quarter < 4; quarter++)
+            {
+                __m128i set = bitMaskSSE2((uint16_t)(words[w] >> (16 * quarter)));
+                _mm_storeu_si128((__m128i *)(out + w * 64 + quarter * 16), _mm_sub_epi8(zeroChar, set));
+            }
+        }
+        return numWords * 64;
+    }
+
+    __attribute__((target("avx2"))) static size_t expandManchesterAVX2(const uint64_t *words, size_t numWords, int8_t *out)
+    {
+        const __m256i one = _mm256_set1_epi8(1);
+        const __m256i two = _mm256_set1_epi8(2);
+        for (size_t w = 0; w < numWords; w++)
+        {
+            for (int half = 0; half < 2; half++)
+            {
+                __m256i set = bitMaskAVX2((uint32_t)(words[w] >> (32 * half)));
+                __m256i second = _mm256_sub_epi8(_mm256_and_si256(set, two), one);
+                __m256i first = _mm256_or_si256(set, one);
+                // unpack interleaves within each 128-bit lane, so put the lanes back in order
+                __m256i lo = _mm256_unpacklo_epi8(first, second);
+                __m256i hi = _mm256_unpackhi_epi8(first, second);
+                int8_t *dst = out + 2 * (w * 64 + half * 32);
+                _mm256_storeu_si256((__m256i *)dst, _mm256_permute2x128_si256(lo, hi, 0x20));
+                _mm256_storeu_si256((__m256i *)(dst + 32), _mm256_permute2x128_si256(lo, hi, 0x31));
+            }
+        }
+        return numWords * 64;
+    }
+
+    __attribute__((target("sse2"))) static size_t expandManchesterSSE2(const uint64_t *words, size_t numWords, int8_t *out)
+    {
+        const __m128i one = _mm_set1_epi8(1);
+        const __m128i two = _mm_set1_epi8(2);
+        for (size_t w = 0; w < numWords; w++)
+        {
+            for (int quarter = 0; quarter < 4; quarter++)
+            {
+                __m128i set = bitMaskSSE2((uint16_t)(words[w] >> (16 * quarter)));
+                __m128i second = _mm_sub_epi8(_mm_and_si128(set, two), one);
+                __m128i first = _mm_or_si128(set, one);
+                int8_t *dst = out + 2 * (w * 64 + quarter * 16);
+                _mm_storeu_si128((__m128i *)dst, _mm_unpacklo_epi8(first, second));
+                _mm_storeu_si128((__m128i *)(dst + 16), _mm_unpackhi_epi8(first, second));
+            }
+        }
+        return numWords * 64;
+    }
+
+    __attribute__((target("avx2"))) static size_t expandAMIAVX2(const uint64_t *words, size_t numWords, int8_t *out, uint64_t &parity)
+    {
+        const __m256i one = _mm256_set1_epi8(1);
+        for (size_t w = 0; w < numWords; w++)
+        {
+            uint64_t odd = prefixXor(words[w]) ^ parity;
+            parity = 0 - (odd >> 63);
+            for (int half = 0; half < 2; half++)
+            {
+                __m256i mark = bitMaskAVX2((uint32_t)(words[w] >> (32 * half)));
+                __m256i negative = bitMaskAVX2((uint32_t)(odd >> (32 * half)));
+                __m256i level = _mm256_and_si256(mark, _mm256_or_si256(negative, one));
+                _mm256_storeu_si256((__m256i *)(out + w * 64 + half * 32), level);
+            }
+        }
+        return numWords * 64;
+    }
+
+    __attribute__((target("sse2"))) static size_t expandAMISSE2(const uint64_t *words, size_t numWords, int8_t *out, uint64_t &parity)
+    {
+        const __m128i one = _mm_set1_epi8(1);
+        for (size_t w = 0; w < numWords; w++)
+        {
+            uint64_t odd = prefixXor(words[w]) ^ parity;
+            parity = 0 - (odd >> 63);
+            for (int quarter = 0; quarter < 4; quarter++)
+            {
+                __m128i mark = bitMaskSSE2((uint16_t)(words[w] >> (16 * quarter)));
+                __m128i negative = bitMaskSSE2((uint16_t)(odd >> (16 * quarter)));
+                __m128i level = _mm_and_si128(mark, _mm_or_si128(negative, one));
+                _mm_storeu_si128((__m128i *)(out + w * 64 + quarter * 16), level);
+            }
+        }
+        return numWords * 64;
+    }
+#endif
+};
+
+// ==================== THREAD POOL ====================
+
+class ThreadPool
+{
+public:
+    explicit ThreadPool(unsigned numWorkers)
+        : current(nullptr), nextIndex(0), total(0), pending(0), failure(nullptr), stopping(false)
+    {
+        for (unsigned i = 0; i < numWorkers; i++)
+        {
+            workers.push_back(thread(&ThreadPool::workerLoop, this));
+        }
+    }
+
+    ~ThreadPool()
+    {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (thread &worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    // Threads that take part in run(): the workers plus the calling thread.
+    size_t concurrency() const { return workers.size() + 1; }
+
+    // Calls task(0) .. task(count - 1) across the pool and returns once all have finished.
+    // If tasks throw, the rest still run and the first exception is rethrown here.
+    void run(size_t count, const function<void(size_t)> &task)
+    {
+        lock_guard<mutex> single(runLock);
+        unique_lock<mutex> guard(lock);
+        current = &task;
+        nextIndex = 0;
+        total = count;
+        pending = count;
+        wake.notify_all();
+
+        while (nextIndex < total)
+        {
+            size_t index = nextIndex++;
+            guard.unlock();
+            exception_ptr error = attempt(task, index);
+            guard.lock();
+            keep(error);
+            pending--;
+        }
+        while (pending != 0)
+        {
+            finished.wait(guard);
+        }
+        current = nullptr;
+        exception_ptr error = failure;
+        failure = nullptr;
+        if (error)
+            rethrow_exception(error);
+    }
+
+    static ThreadPool &shared()
+    {
+        static ThreadPool pool(max(1u, thread::hardware_concurrency()) - 1);
+        return pool;
+    }
+
+private:
+    vector<thread> workers;
+    mutex runLock;
+    mutex lock;
+    condition_variable wake;
+    condition_variable finished;
+    const function<void(size_t)> *current;
+    size_t nextIndex;
+    size_t total;
+    size_t pending;
+    exception_ptr failure;
+    bool stopping;
+
+    // Runs one task with the lock released, handing back what it threw.
+    static exception_ptr attempt(const function<void(size_t)> &task, size_t index)
+    {
+        try
+        {
+            task(index);
+        }
+        catch (...)
+        {
+            return current_exception();
+        }
+        return nullptr;
+    }
+
+    // Called with the lock held; only the first failure of a run is reported.
+    void keep(const exception_ptr &error)
+    {
+        if (error && !failure)
+            failure = error;
+    }
+
+    void workerLoop()
+    {
+        unique_lock<mutex> guard(lock);
+        while (true)
+        {
+            while (!stopping && nextIndex >= total)
+            {
+                wake.wait(guard);
+            }
+            if (stopping)
+                return;
+
+            size_t index = nextIndex++;
+            const function<void(size_t)> &task = *current;
+            guard.unlock();
+            exception_ptr error = attempt(task, index);
+            guard.lock();
+            keep(error);
+            if (--pending == 0)
+                finished.notify_all();
+        }
+    }
+};
+
+// ==================== LINE CODE POLICIES ====================
+
+// Names the base line codes for the kernel dispatchers; the CLI numbers its menu from
+// LineCodeRegistry, not from these values.
+enum class LineCodeScheme
+{
+    NRZL,
+    NRZI,
+    Manchester,
+    DifferentialManchester,
+    AMI,
+    MLT3
+};
+
+// A line-code policy bundles one scheme's encode and decode kernels with its samples per
+// bit and level alphabet. Code written against a policy (LinePipeline, StreamingEncoder,
+// LineEncoder::encodeParallel) is instantiated per scheme, so the kernels inline into it.
+//
+//   encode(words, numBits, out, state)  writes samplesPerBit * numBits levels; state is
+//                                       carried between calls by stateful codes
+//   decode(signal, numBits, out)        writes numBits '0'/'1' characters
+//   decodePacked(signal, numBits, bits, level)
+//                                       packs numBits bits, LSB first, into whole words;
+//                                       level carries prevLevel or prevEndLevel between
+//                                       calls and starts at startLevel
+//   stateOf(words, numWords)            the state a run of words leaves behind from zero
+//   combine(state, next)                the state after a run, given its start state
+
+// State carried as the parity of the ones so far, 0 or all ones. Codes without state
+// take it too so that the same generic code compiles for them.
+struct ParityState
+{
+    static uint64_t stateOf(const uint64_t *words, size_t numWords)
+    {
+        return LevelKernels::parityOf(words, numWords);
+    }
+
+    static uint64_t combine(uint64_t state, uint64_t next)
+    {
+        return state ^ next;
+    }
+};
+
+// Runs a pack kernel over 4096-bit stack blocks and expands each block to characters.
+template <class PackBlock>
+void decodeInBlocks(const int8_t *signal, size_t numBits, size_t samplesPerBit, char *out, PackBlock pack)
+{
+    const size_t blockBits = 4096;
+    uint64_t bits[blockBits / 64];
+    for (size_t first = 0; first < numBits; first += blockBits)
+    {
+        size_t count = min(blockBits, numBits - first);
+        pack(signal + samplesPerBit * first, count, bits);
+        LevelKernels::expandChars(bits, count, out + first);
+    }
+}
+
+// NRZ-L and AMI decode as masks straight from packLevels: positive or nonzero samples.
+inline void packMarks(const int8_t *signal, size_t n, uint64_t *bits, bool nonzero)
+{
+    const size_t blockBits = 4096;
+    uint64_t positive[blockBits / 64], zero[blockBits / 64];
+    for (size_t first = 0; first < n; first += blockBits)
+    {
+        size_t count = min(blockBits, n - first);
+        LevelKernels::packLevels(signal + first, count, positive, zero);
+        for (size_t w = 0; w < (count + 63) / 64; w++)
+        {
+            bits[first / 64 + w] = nonzero ? ~zero[w] : positive[w];
+        }
+    }
+    if (n & 63)
+        bits[n / 64] &= ((uint64_t)1 << (n & 63)) - 1;
+}
+
+struct NrzlCode : ParityState
+{
+    static const LineCodeScheme scheme = LineCodeScheme::NRZL;
+    static const size_t samplesPerBit = 1;
+    static const int8_t startLevel = 0;
+    static const bool stateful = false;
+    static const char *name() { return "NRZ-L"; }
+    static bool isLevel(int8_t level) { return level == -1 || level == 1; }
+
+    static void encode(const uint64_t *words, size_t numBits, int8_t *out, uint64_t &)
+    {
+        LevelKernels::expandNRZ(words, numBits, out);
+    }
+
+    static void decode(const int8_t *signal, size_t numBits, char *out)
+    {
+        for (size_t i = 0; i < numBits; i++)
+        {
+            out[i] = (signal[i] > 0) ? '1' : '0';
+        }
+    }
+
+    static void decodePacked(const int8_t *signal, size_t numBits, uint64_t *bits, int8_t &)
+    {
+        packMarks(signal, numBits, bits, false);
+    }
+};
+
+struct NrziCode : ParityState
+{
+    static const LineCodeScheme scheme = LineCodeScheme::NRZI;
+    static const size_t samplesPerBit = 1;
+    static const int8_t startLevel = -1;
+    static const bool stateful = true;
+    static const char *name() { return "NRZ-I"; }
+    static bool isLevel(int8_t level) { return level == -1 || level == 1; }
+
+    static void encode(const uint64_t *words, size_t numBits, int8_t *out, uint64_t &parity)
+    {
+        LevelKernels::expandNRZI(words, numBits, out, parity);
+    }
+
+    static void decode(const int8_t *signal, size_t numBits, char *out)
+    {
+        int8_t prevLevel = -1;
+        auto pack = [&](const int8_t *block, size_t count, uint64_t *bits)
+        {
+            LevelKernels::packNRZITransitions(block, count, bits, prevLevel);
+        };
+        decodeInBlocks(signal, numBits, samplesPerBit, out, pack);
+    }
+
+    static void decodePacked(const int8_t *signal, size_t numBits, uint64_t *bits, int8_t &prevLevel)
+    {
+        LevelKernels::packNRZITransitions(signal, numBits, bits, prevLevel);
+    }
+};
+
+struct ManchesterCode : ParityState
+{
+    static const LineCodeScheme scheme = LineCodeScheme::Manchester;
+    static const size_t samplesPerBit = 2;
+    static const int8_t startLevel = 0;
+    static const bool stateful = false;
+    static const char *name() { return "Manchester"; }
+    static bool isLevel(int8_t level) { return level == -1 || level == 1; }
+
+    static void encode(const uint64_t *words, size_t numBits, int8_t *out, uint64_t &)
+    {
+        LevelKernels::expandManchester(words, numBits, out);
+    }
+
+    static void decode(const int8_t *signal, size_t numBits, char *out)
+    {
+        decodeInBlocks(signal, numBits, samplesPerBit, out, LevelKernels::packManchester);
+    }
+
+    static void decodePacked(const int8_t *signal, size_t numBits, uint64_t *bits, int8_t &)
+    {
+        LevelKernels::packManchester(signal, numBits, bits);
+    }
+};
+
+struct DifferentialManchesterCode : ParityState
+{
+    static const LineCodeScheme scheme = LineCodeScheme::DifferentialManchester;
+    static const size_t samplesPerBit = 2;
+    static const int8_t startLevel = 1;
+    static const bool stateful = true;
+    static const char *name() { return "Differential Manchester"; }
+    static bool isLevel(int8_t level) { return level == -1 || level == 1; }
+
+    static void encode(const uint64_t *words, size_t numBits, int8_t *out, uint64_t &parity)
+    {
+        LevelKernels::expandDifferentialManchester(words, numBits, out, parity);
+    }
+
+    static void decode(const int8_t *signal, size_t numBits, char *out)
+    {
+        int8_t prevEndLevel = 1;
+        auto pack = [&](const int8_t *block, size_t count, uint64_t *bits)
+        {
+            LevelKernels::packDifferentialManchester(block, count, bits, prevEndLevel);
+        };
+        decodeInBlocks(signal, numBits, samplesPerBit, out, pack);
+    }
+
+    static void decodePacked(const int8_t *signal, size_t numBits, uint64_t *bits, int8_t &prevEndLevel)
+    {
+        LevelKernels::packDifferentialManchester(signal, numBits, bits, prevEndLevel);
+    }
+};
+
+struct AmiCode : ParityState
+{
+    static const LineCodeScheme scheme = LineCodeScheme::AMI;
+    static const size_t samplesPerBit = 1;
+    static const int8_t startLevel = 0;
+    static const bool stateful = true;
+    static const char *name() { return "AMI"; }
+    static bool isLevel(int8_t level) { return level >= -1 && level <= 1; }
+
+    static void encode(const uint64_t *words, size_t numBits, int8_t *out, uint64_t &parity)
+    {
+        LevelKernels::expandAMI(words, numBits, out, parity);
+    }
+
+    static void decode(const int8_t *signal, size_t numBits, char *out)
+    {
+        for (size_t i = 0; i < numBits; i++)
+        {
+            out[i] = (signal[i] == 0) ? '0' : '1';
+        }
+    }
+
+    static void decodePacked(const int8_t *signal, size_t numBits, uint64_t *bits, int8_t &)
+    {
+        packMarks(signal, numBits, bits, true);
+    }
+};
+
+struct Mlt3Code
+{
+    static const LineCodeScheme scheme = LineCodeScheme::MLT3;
+    static const size_t samplesPerBit = 1;
+    static const int8_t startLevel = 0;
+    static const bool stateful = true;
+    static const char *name() { return "MLT-3"; }
+    static bool isLevel(int8_t level) { return level >= -1 && level <= 1; }
+
+    // state is the count of ones mod 4.
+    static void encode(const uint64_t *words, size_t numBits, int8_t *out, uint64_t &count)
+    {
+        LevelKernels::expandMLT3(words, numBits, out, count);
+    }
+
+    // A one is any change of level, which the NRZ-I kernel already finds on three levels.
+    static void decode(const int8_t *signal, size_t numBits, char *out)
+    {
+        int8_t prevLevel = 0;
+        auto pack = [&](const int8_t *block, size_t count, uint64_t *bits)
+        {
+            LevelKernels::packNRZITransitions(block, count, bits, prevLevel);
+        };
+        decodeInBlocks(signal, numBits, samplesPerBit, out, pack);
+    }
+
+    static void decodePacked(const int8_t *signal, size_t numBits, uint64_t *bits, int8_t &prevLevel)
+    {
+        LevelKernels::packNRZITransitions(signal, numBits, bits, prevLevel);
+    }
+
+    static uint64_t stateOf(const uint64_t *words, size_t numWords)
+    {
+        uint64_t count = 0;
+        for (size_t w = 0; w < numWords; w++)
+        {
+            count += LevelKernels::popCount(words[w]);
+        }
+        return count & 3;
+    }
+
+    static uint64_t combine(uint64_t count, uint64_t next)
+    {
+        return (count + next) & 3;
+    }
+
+};
+
+// ==================== BLOCK CODES ====================
+
+// Block codes map data bits to code groups before a line code puts them on the wire.
+// Data bits are taken least significant bit first, the order BitStream stores them in,
+// and code-group bits go out in the order the standards list them (a, b, c, ...).
+
+constexpr unsigned reverseBits(unsigned value, int count)
+{
+    unsigned reversed = 0;
+    for (int i = 0; i < count; i++)
+    {
+        reversed = (reversed << 1) | ((value >> i) & 1);
+    }
+    return reversed;
+}
+
+constexpr unsigned countOnes(unsigned value)
+{
+    unsigned count = 0;
+    for (; value; value &= value - 1)
+    {
+        count++;
+    }
+    return count;
+}
+
+// Byte-at-a-time block code tables, generated at compile time. Decode entries hold the
+// data byte, with bit 8 set for code groups that are not valid data.
+struct BlockCodeTables
+{
+    uint16_t fourB5B[256];          // two nibbles -> two 5-bit groups
+    uint16_t fourB5BDecode[1024];
+    uint16_t eightB10B[2][256];     // [running disparity +][byte] -> 10-bit group, bit 10 = new disparity
+    uint16_t eightB10BDecode[1024];
+};
+
+constexpr BlockCodeTables makeBlockCodeTables()
+{
+    // Code groups as listed, first transmitted bit leftmost.
+    const uint8_t fourB5B[16] = {0b11110, 0b01001, 0b10100, 0b10101, 0b01010, 0b01011, 0b01110, 0b01111,
+                                 0b10010, 0b10011, 0b10110, 0b10111, 0b11010, 0b11011, 0b11100, 0b11101};
+    // abcdei and fghj for running disparity -; the + form is the complement where they differ.
+    const uint8_t fiveB6B[32] = {0b100111, 0b011101, 0b101101, 0b110001, 0b110101, 0b101001, 0b011001, 0b111000,
+                                 0b111001, 0b100101, 0b010101, 0b110100, 0b001101, 0b101100, 0b011100, 0b010111,
+                                 0b011011, 0b100011, 0b010011, 0b110010, 0b001011, 0b101010, 0b011010, 0b111010,
+                                 0b110011, 0b100110, 0b010110, 0b110110, 0b001110, 0b101110, 0b011110, 0b101011};
+    const uint8_t threeB4B[8] = {0b1011, 0b1001, 0b0101, 0b1100, 0b1101, 0b1010, 0b0110, 0b1110};
+    const uint8_t alternate7 = 0b0111;
+
+    BlockCodeTables t{};
+    uint8_t fourB5BNibble[32] = {};
+    for (unsigned g = 0; g < 32; g++)
+    {
+        fourB5BNibble[g] = 0x10;
+    }
+    for (unsigned nibble = 0; nibble < 16; nibble++)
+    {
+        fourB5BNibble[reverseBits(fourB5B[nibble], 5)] = nibble;
+    }
+    for (unsigned b = 0; b < 256; b++)
+    {
+        t.fourB5B[b] = reverseBits(fourB5B[b & 15], 5) | reverseBits(fourB5B[b >> 4], 5) << 5;
+    }
+    for (unsigned g = 0; g < 1024; g++)
+    {
+        unsigned low = fourB5BNibble[g & 31], high = fourB5BNibble[g >> 5];
+        t.fourB5BDecode[g] = (low & 15) | (high & 15) << 4 | ((low | high) & 0x10) << 4;
+    }
+
+    for (unsigned g = 0; g < 1024; g++)
+    {
+        t.eightB10BDecode[g] = 0x100;
+    }
+    for (unsigned positive = 0; positive < 2; positive++)
+    {
+        for (unsigned b = 0; b < 256; b++)
+        {
+            unsigned x = b & 31, y = b >> 5;
+            unsigned six = fiveB6B[x];
+            bool sixUnbalanced = countOnes(six) != 3;
+            if (positive && (sixUnbalanced || x == 7))
+                six = ~six & 63;
+            unsigned middle = sixUnbalanced ? !positive : positive;
+
+            unsigned four = threeB4B[y];
+            if (y == 7 && ((!middle && (x == 17 || x == 18 || x == 20)) || (middle && (x == 11 || x == 13 || x == 14))))
+                four = alternate7;
+            bool fourUnbalanced = countOnes(four) != 2;
+            if (middle && (fourUnbalanced || y == 3))
+                four = ~four & 15;
+            unsigned end = fourUnbalanced ? !middle : middle;
+
+            unsigned group = reverseBits(six, 6) | reverseBits(four, 4) << 6;
+            t.eightB10B[positive][b] = group | end << 10;
+            t.eightB10BDecode[group] = b;
+        }
+    }
+    return t;
+}
+
+const BlockCodeTables &blockCodeTables()
+{
+    static constexpr BlockCodeTables t = makeBlockCodeTables();
+    return t;
+}
+
+// Each block code takes data padded with zeros to whole blocks and decodes code groups
+// back to data; groups that are not valid data decode to zeros and are counted.
+struct Block4B5B
+{
+    static const size_t dataBits = 4;
+    static const size_t codeBits = 5;
+    static const char *name() { return "4B/5B"; }
+
+    static BitStream encode(const BitStream &data)
+    {
+        const BlockCodeTables &t = blockCodeTables();
+        size_t numBlocks = (data.size() + dataBits - 1) / dataBits;
+        BitStream code;
+        code.reserve(numBlocks * codeBits);
+        size_t i = 0;
+        for (; i + 8 <= data.size(); i += 8)
+        {
+            code.appendBits(t.fourB5B[data.getBits(i, 8)], 10);
+        }
+        if (i < data.size())
+        {
+            unsigned nibbles = data.getBits(i, (int)(data.size() - i));
+            code.appendBits(t.fourB5B[nibbles], (int)(numBlocks * codeBits - code.size()));
+        }
+        return code;
+    }
+
+    static BitStream decode(const BitStream &code, size_t &invalidGroups)
+    {
+        const BlockCodeTables &t = blockCodeTables();
+        size_t numBlocks = code.size() / codeBits;
+        BitStream data;
+        data.reserve(numBlocks * dataBits);
+        invalidGroups = 0;
+        size_t i = 0;
+        for (; i + 10 <= numBlocks * codeBits; i += 10)
+        {
+            unsigned entry = t.fourB5BDecode[code.getBits(i, 10)];
+            invalidGroups += entry >> 8;
+            data.appendBits(entry >> 8 ? 0 : entry, 8);
+        }
+        if (i < numBlocks * codeBits)
+        {
+            unsigned entry = t.fourB5BDecode[code.getBits(i, 5) | 0b01111 << 5];
+            invalidGroups += entry >> 8;
+            data.appendBits(entry >> 8 ? 0 : entry, 4);
+        }
+        return data;
+    }
+};
+
+// 8b/10b data characters with running disparity. Control characters are not emitted,
+// and decoding accepts any group valid for either disparity.
+struct Block8B10B
+{
+    static const size_t dataBits = 8;
+    static const size_t codeBits = 10;
+    static const char *name() { return "8b/10b"; }
+
+    static BitStream encode(const BitStream &data)
+    {
+        bool positive = false;
+        return encode(data, positive);
+    }
+
+    // Streaming form: positive carries the running disparity, starting at -.
+    static BitStream encode(const BitStream &data, bool &positive)
+    {
+        const BlockCodeTables &t = blockCodeTables();
+        size_t numBlocks = (data.size() + dataBits - 1) / dataBits;
+        BitStream code;
+        code.reserve(numBlocks * codeBits);
+        for (size_t i = 0; i < data.size(); i += 8)
+        {
+            unsigned entry = t.eightB10B[positive][data.getBits(i, (int)min((size_t)8, data.size() - i))];
+            code.appendBits(entry, 10);
+            positive = entry >> 10;
+        }
+        return code;
+    }
+
+    static BitStream decode(const BitStream &code, size_t &invalidGroups)
+    {
+        const BlockCodeTables &t = blockCodeTables();
+        size_t numBlocks = code.size() / codeBits;
+        BitStream data;
+        data.reserve(numBlocks * dataBits);
+        invalidGroups = 0;
+        for (size_t i = 0; i < numBlocks * codeBits; i += 10)
+        {
+            unsigned entry = t.eightB10BDecode[code.getBits(i, 10)];
+            invalidGroups += entry >> 8;
+            data.appendBits(entry >> 8 ? 0 : entry, 8);
+        }
+        return data;
+    }
+};
+
+// 64b/66b framing of data blocks: a 01 sync header in front of each 64-bit word. The
+// payload goes out as is; scramble the data with Scrambler58 first for 10GBASE-R.
+struct Block64B66B
+{
+    static const size_t dataBits = 64;
+    static const size_t codeBits = 66;
+    static const char *name() { return "64b/66b"; }
+
+    static BitStream encode(const BitStream &data)
+    {
+        size_t numBlocks = data.wordCount();
+        BitStream code;
+        code.reserve(numBlocks * codeBits);
+        for (size_t w = 0; w < numBlocks; w++)
+        {
+            code.appendBits(syncData, 2);
+            code.appendBits(data.data()[w], 64);
+        }
+        return code;
+    }
+
+    static BitStream decode(const BitStream &code, size_t &invalidGroups)
+    {
+        size_t numBlocks = code.size() / codeBits;
+        BitStream data;
+        data.reserve(numBlocks * dataBits);
+        invalidGroups = 0;
+        for (size_t i = 0; i < numBlocks * codeBits; i += codeBits)
+        {
+            bool valid = code.getBits(i, 2) == syncData;
+            invalidGroups += !valid;
+            data.appendBits(valid ? code.getBits(i + 2, 64) : 0, 64);
+        }
+        return data;
+    }
+
+private:
+    static const unsigned syncData = 0b10; // 0 then 1, read LSB first
+};
+
+// ==================== SELF-SYNCHRONIZING SCRAMBLERS ====================
+
+// Multiplicative scrambler for 1 + x^TapA + x^TapB (TapB = 0 for two terms): each output
+// bit is the input bit XOR the outputs TapA and TapB bits back, and the descrambler
+// XORs the same taps of its input, so it locks on after TapA bits without a reset.
+// history holds the last 64 scrambled bits, most recent in bit 63, and starts at zero.
+//
+// A word is done in one go: the bits that reach back into the previous word come from
+// history, and the recursion inside the word is (1 + S)^-1 = (1 + S)(1 + S^2)(1 + S^4)...
+// with S the tap shifts, where S^(2^i) just scales the shifts by 2^i.
+template <int TapA, int TapB = 0>
+struct MultiplicativeScrambler
+{
+    static_assert(TapA > TapB && TapA < 64 && TapB >= 0, "taps must fit in one word");
+
+    static void scramble(const uint64_t *in, size_t numBits, uint64_t *out, uint64_t &history)
+    {
+        for (size_t first = 0; first < numBits; first += 64)
+        {
+            size_t n = min((size_t)64, numBits - first);
+            uint64_t y = in[first / 64] ^ fromHistory(history);
+            for (int shift = 1; shortestTap * shift < 64; shift *= 2)
+            {
+                y ^= taps(y, shift);
+            }
+            if (n < 64)
+                y &= ((uint64_t)1 << n) - 1;
+            out[first / 64] = y;
+            history = advance(history, y, n);
+        }
+    }
+
+    static void descramble(const uint64_t *in, size_t numBits, uint64_t *out, uint64_t &history)
+    {
+        for (size_t first = 0; first < numBits; first += 64)
+        {
+            size_t n = min((size_t)64, numBits - first);
+            uint64_t y = in[first / 64];
+            if (n < 64)
+                y &= ((uint64_t)1 << n) - 1;
+            uint64_t x = y ^ taps(y, 1) ^ fromHistory(history);
+            if (n < 64)
+                x &= ((uint64_t)1 << n) - 1;
+            out[first / 64] = x;
+            history = advance(history, y, n);
+        }
+    }
+
+private:
+    static const int shortestTap = TapB > 0 ? TapB : TapA;
+
+    // In-word tap terms with every shift scaled by `shift`; shifts past the word drop out.
+    static uint64_t taps(uint64_t y, int shift)
+    {
+        uint64_t t = 0;
+        if (TapA * shift < 64)
+            t ^= y << (TapA * shift);
+        if (TapB > 0 && TapB * shift < 64)
+            t ^= y << (TapB * shift);
+        return t;
+    }
+
+    // Tap terms of a word's first bits, which reach back into the previous words.
+    static uint64_t fromHistory(uint64_t history)
+    {
+        uint64_t t = history >> (64 - TapA);
+        if (TapB > 0)
+            t ^= history >> (64 - TapB);
+        return t;
+    }
+
+    static uint64_t advance(uint64_t history, uint64_t y, size_t n)
+    {
+        if (n == 64)
+            return y;
+        return (history >> n) | (y << (64 - n));
+    }
+};
+
+typedef MultiplicativeScrambler<7, 4> Scrambler7;   // 1 + x^4 + x^7
+typedef MultiplicativeScrambler<43> Scrambler43;    // 1 + x^43, SONET/SDH and ATM payloads
+typedef MultiplicativeScrambler<58, 39> Scrambler58; // 1 + x^39 + x^58, 64b/66b
+
+// ==================== LINE ENCODING SCHEMES ====================
+
+class LineEncoder
+{
+public:
+    // Samples produced for numBits input bits: two per bit for the Manchester codes.
+    static size_t encodedLength(LineCodeScheme scheme, size_t numBits)
+    {
+        if (scheme == LineCodeScheme::Manchester || scheme == LineCodeScheme::DifferentialManchester)
+            return 2 * numBits;
+        return numBits;
+    }
+
+    template <class Code>
+    static void encodeInto(const BitStream &data, int8_t *out)
+    {
+        uint64_t parity = 0;
+        Code::encode(data.data(), data.size(), out, parity);
+    }
+
+    // Writes encodedLength() samples to out and returns that count.
+    static size_t encodeInto(const BitStream &data, LineCodeScheme scheme, int8_t *out)
+    {
+        switch (scheme)
+        {
+        case LineCodeScheme::NRZL:
+            encodeInto<NrzlCode>(data, out);
+            break;
+        case LineCodeScheme::NRZI:
+            encodeInto<NrziCode>(data, out);
+            break;
+        case LineCodeScheme::Manchester:
+            encodeInto<ManchesterCode>(data, out);
+            break;
+        case LineCodeScheme::DifferentialManchester:
+            encodeInto<DifferentialManchesterCode>(data, out);
+            break;
+        case LineCodeScheme::AMI:
+            encodeInto<AmiCode>(data, out);
+            break;
+        case LineCodeScheme::MLT3:
+            encodeInto<Mlt3Code>(data, out);
+            break;
+        }
+        return encodedLength(scheme, data.size());
+    }
+
+    // Reuses out's capacity, so a buffer kept across calls stops allocating once it is large enough.
+    static void encodeInto(const BitStream &data, LineCodeScheme scheme, Signal &out)
+    {
+        out.resize(encodedLength(scheme, data.size()));
+        encodeInto(data, scheme, out.data());
+    }
+
+    static Signal encodeNRZL(const BitStream &data)
+    {
+        Signal signal;
+        encodeInto(data, LineCodeScheme::NRZL, signal);
+        return signal;
+    }
+
+    static Signal encodeNRZI(const BitStream &data)
+    {
+        Signal signal;
+        encodeInto(data, LineCodeScheme::NRZI, signal);
+        return signal;
+    }
+
+    static Signal encodeManchester(const BitStream &data)
+    {
+        Signal signal;
+        encodeInto(data, LineCodeScheme::Manchester, signal);
+        return signal;
+    }
+
+    static Signal encodeDifferentialManchester(const BitStream &data)
+    {
+        Signal signal;
+        encodeInto(data, LineCodeScheme::DifferentialManchester, signal);
+        return signal;
+    }
+
+    static Signal encodeAMI(const BitStream &data)
+    {
+        Signal signal;
+        encodeInto(data, LineCodeScheme::AMI, signal);
+        return signal;
+    }
+
+    static Signal encodeMLT3(const BitStream &data)
+    {
+        Signal signal;
+        encodeInto(data, LineCodeScheme::MLT3, signal);
+        return signal;
+    }
+
+    // Self-synchronizing scrambling of the data bits. history carries the last 64
+    // scrambled bits between calls and starts at zero.
+    template <class Scrambler>
+    static BitStream scramble(const BitStream &data, uint64_t &history)
+    {
+        BitStream bits;
+        bits.resize(data.size());
+        Scrambler::scramble(data.data(), data.size(), bits.data(), history);
+        return bits;
+    }
+
+    template <class Scrambler>
+    static BitStream scramble(const BitStream &data)
+    {
+        uint64_t history = 0;
+        return scramble<Scrambler>(data, history);
+    }
+
+    // A block code followed by the line code that carries its code groups.
+    template <class Block, class Code>
+    static Signal encodeBlockCoded(const BitStream &data)
+    {
+        BitStream code = Block::encode(data);
+        Signal signal(Code::samplesPerBit * code.size());
+        encodeInto<Code>(code, signal.data());
+        return signal;
+    }
+
+    // 4B/5B over NRZ-I as in FDDI, or over MLT-3 as in 100BASE-TX.
+    static Signal encode4B5B(const BitStream &data, LineCodeScheme line = LineCodeScheme::NRZI)
+    {
+        if (line == LineCodeScheme::MLT3)
+            return encodeBlockCoded<Block4B5B, Mlt3Code>(data);
+        return encodeBlockCoded<Block4B5B, NrziCode>(data);
+    }
+
+    static Signal encode8B10B(const BitStream &data)
+    {
+        return encodeBlockCoded<Block8B10B, NrzlCode>(data);
+    }
+
+    static Signal encode64B66B(const BitStream &data)
+    {
+        return encodeBlockCoded<Block64B66B, NrzlCode>(data);
+    }
+
+    // Splits the input into word-aligned chunks, one per pool thread. Stateful codes depend
+    // on all earlier ones, so a first pass takes each chunk's own state, an exclusive scan
+    // turns those into starting states, and the second pass encodes every chunk
+    // independently. Output is identical to the serial encoders.
+    template <class Code>
+    static Signal encodeParallel(const BitStream &data, ThreadPool &pool = ThreadPool::shared())
+    {
+        const size_t minChunkWords = 1024;
+        Signal signal(Code::samplesPerBit * data.size());
+
+        size_t numWords = data.wordCount();
+        size_t numChunks = max((size_t)1, min(pool.concurrency(), numWords / minChunkWords));
+        size_t chunkWords = (numWords + numChunks - 1) / numChunks;
+        const uint64_t *words = data.data();
+
+        vector<uint64_t> startState(numChunks, 0);
+        if (Code::stateful)
+        {
+            auto chunkState = [&](size_t c)
+            {
+                size_t firstWord = c * chunkWords;
+                if (firstWord < numWords)
+                    startState[c] = Code::stateOf(words + firstWord, min(chunkWords, numWords - firstWord));
+            };
+            pool.run(numChunks, chunkState);
+
+            uint64_t carry = 0;
+            for (size_t c = 0; c < numChunks; c++)
+            {
+                uint64_t ownState = startState[c];
+                startState[c] = carry;
+                carry = Code::combine(carry, ownState);
+            }
+        }
+
+        auto encodeChunk = [&](size_t c)
+        {
+            size_t first = c * chunkWords * 64;
+            if (first >= data.size())
+                return;
+            size_t count = min(chunkWords * 64, data.size() - first);
+            uint64_t state = startState[c];
+            Code::encode(words + c * chunkWords, count, signal.data() + Code::samplesPerBit * first, state);
+        };
+        pool.run(numChunks, encodeChunk);
+        return signal;
+    }
+
+    static Signal encodeParallel(const BitStream &data, LineCodeScheme scheme, ThreadPool &pool = ThreadPool::shared())
+    {
+        switch (scheme)
+        {
+        case LineCodeScheme::NRZL:
+            return encodeParallel<NrzlCode>(data, pool);
+        case LineCodeScheme::NRZI:
+            return encodeParallel<NrziCode>(data, pool);
+        case LineCodeScheme::Manchester:
+            return encodeParallel<ManchesterCode>(data, pool);
+        case LineCodeScheme::DifferentialManchester:
+            return encodeParallel<DifferentialManchesterCode>(data, pool);
+        case LineCodeScheme::AMI:
+            return encodeParallel<AmiCode>(data, pool);
+        case LineCodeScheme::MLT3:
+            return encodeParallel<Mlt3Code>(data, pool);
+        }
+        return Signal();
+    }
+
+    // AMI and B8ZS in one pass over the bits. The output is zeroed once, then each mark is
+    // written together with the complete runs of eight zeros in front of it. Substituted
+    // runs end on the polarity they started from, so the last mark's polarity is all the
+    // state there is.
+    static void encodeAMIB8ZSInto(const BitStream &data, int8_t *out)
+    {
+        size_t n = data.size();
+        if (n == 0)
+            return;
+        memset(out, 0, n);
+        int8_t pulse = 1;
+        size_t runStart = 0;
+        for (size_t w = 0; w < data.wordCount(); w++)
+        {
+            uint64_t marks = data.data()[w];
+            while (marks)
+            {
+                size_t m = w * 64 + LevelKernels::countTrailingZeros(marks);
+                marks &= marks - 1;
+                substituteB8ZS(out, runStart, m, pulse);
+                pulse = -pulse;
+                out[m] = pulse;
+                runStart = m + 1;
+            }
+        }
+        substituteB8ZS(out, runStart, n, pulse);
+    }
+
+    static Signal encodeAMIB8ZS(const BitStream &data)
+    {
+        Signal signal(data.size());
+        encodeAMIB8ZSInto(data, signal.data());
+        return signal;
+    }
+
+    // AMI and HDB3 in one pass, in the same way as encodeAMIB8ZSInto. Marks alternate
+    // against the last pulse sent, substituted ones included.
+    static void encodeAMIHDB3Into(const BitStream &data, int8_t *out)
+    {
+        size_t n = data.size();
+        if (n == 0)
+            return;
+        memset(out, 0, n);
+        int8_t lastPulse = 1;
+        int pulseCount = 0;
+        size_t runStart = 0;
+        for (size_t w = 0; w < data.wordCount(); w++)
+        {
+            uint64_t marks = data.data()[w];
+            while (marks)
+            {
+                size_t m = w * 64 + LevelKernels::countTrailingZeros(marks);
+                marks &= marks - 1;
+                substituteHDB3(out, runStart, m, lastPulse, pulseCount);
+                lastPulse = -lastPulse;
+                out[m] = lastPulse;
+                pulseCount++;
+                runStart = m + 1;
+            }
+        }
+        substituteHDB3(out, runStart, n, lastPulse, pulseCount);
+    }
+
+    static Signal encodeAMIHDB3(const BitStream &data)
+    {
+        Signal signal(data.size());
+        encodeAMIHDB3Into(data, signal.data());
+        return signal;
+    }
+
+    static Signal scrambleB8ZS(Signal signal)
+    {
+        int8_t lastPulse = 1;
+        scrambleB8ZSInPlace(signal.data(), signal.size(), lastPulse);
+        return signal;
+    }
+
+    // HDB3 re-alternates the pulses after every substitution, so only the positions of
+    // the input's pulses are kept.
+    static Signal scrambleHDB3(Signal signal)
+    {
+        int8_t lastPulse = 1;
+        int pulseCount = 0;
+        scrambleHDB3InPlace(signal.data(), signal.size(), lastPulse, pulseCount);
+        return signal;
+    }
+
+    // In-place scramblers with the running state passed in. Only the pulses are visited;
+    // the zero runs between them are measured from their positions and just the
+    // substituted samples are rewritten. Returns the number of trailing zeros that are
+    // short of a complete run, which a streaming caller holds back.
+    static size_t scrambleB8ZSInPlace(int8_t *signal, size_t n, int8_t &lastPulse)
+    {
+        size_t runStart = 0;
+        LevelKernels::forEachNonzero(signal, n, [&](size_t i)
+        {
+            substituteB8ZS(signal, runStart, i, lastPulse);
+            lastPulse = signal[i];
+            runStart = i + 1;
+        });
+        substituteB8ZS(signal, runStart, n, lastPulse);
+        return n - runStart;
+    }
+
+    static size_t scrambleHDB3InPlace(int8_t *signal, size_t n, int8_t &lastPulse, int &pulseCount)
+    {
+        size_t runStart = 0;
+        LevelKernels::forEachNonzero(signal, n, [&](size_t i)
+        {
+            substituteHDB3(signal, runStart, i, lastPulse, pulseCount);
+            lastPulse = -lastPulse;
+            signal[i] = lastPulse;
+            pulseCount++;
+            runStart = i + 1;
+        });
+        substituteHDB3(signal, runStart, n, lastPulse, pulseCount);
+        return n - runStart;
+    }
+
+private:
+    // Writes 000VB0VB over each complete run of eight zeros in [runStart, end). The
+    // samples in between must already be zero.
+    static void substituteB8ZS(int8_t *signal, size_t &runStart, size_t end, int8_t lastPulse)
+    {
+        for (; runStart + 8 <= end; runStart += 8)
+        {
+            signal[runStart + 3] = lastPulse;
+            signal[runStart + 4] = -lastPulse;
+            signal[runStart + 6] = -lastPulse;
+            signal[runStart + 7] = lastPulse;
+        }
+    }
+
+    // Writes 000V over each complete run of four zeros in [runStart, end) when an odd
+    // number of pulses went out since the last substitution, and B00V when it was even,
+    // so consecutive violations alternate in polarity.
+    static void substituteHDB3(int8_t *signal, size_t &runStart, size_t end, int8_t &lastPulse, int &pulseCount)
+    {
+        for (; runStart + 4 <= end; runStart += 4)
+        {
+            if (pulseCount % 2 == 0)
+            {
+                lastPulse = -lastPulse;
+                signal[runStart] = lastPulse;
+            }
+            signal[runStart + 3] = lastPulse;
+            pulseCount = 0;
+        }
+    }
+};
+
+// ==================== STREAMING ENCODERS ====================
+
+// Stateful counterparts of the LineEncoder functions for input that arrives in chunks.
+// push() returns the samples that are final so far and flush() returns whatever is
+// still held back and resets the encoder for the next stream. Concatenated, the
+// outputs equal the one-shot LineEncoder output.
+
+template <class Code>
+class StreamingEncoder
+{
+public:
+    StreamingEncoder() : parity(0) {}
+
+    Signal push(const BitStream &chunk)
+    {
+        Signal signal(Code::samplesPerBit * chunk.size());
+        Code::encode(chunk.data(), chunk.size(), signal.data(), parity);
+        return signal;
+    }
+
+    Signal flush()
+    {
+        parity = 0;
+        return Signal();
+    }
+
+private:
+    uint64_t parity;
+};
+
+typedef StreamingEncoder<NrziCode> NrziEncoder;
+typedef StreamingEncoder<DifferentialManchesterCode> DifferentialManchesterEncoder;
+typedef StreamingEncoder<AmiCode> AmiEncoder;
+
+// Chunked counterparts of LineEncoder::scrambleB8ZS and scrambleHDB3. Trailing zeros
+// that are still short of a substituted run are held back until the next chunk decides
+// them, so runs that straddle a chunk boundary are substituted like any other.
+class B8zsScrambler
+{
+public:
+    B8zsScrambler() : pendingZeros(0), lastPulse(1) {}
+
+    Signal push(const Signal &chunk)
+    {
+        Signal signal(pendingZeros, 0);
+        signal.insert(signal.end(), chunk.begin(), chunk.end());
+        pendingZeros = LineEncoder::scrambleB8ZSInPlace(signal.data(), signal.size(), lastPulse);
+        signal.resize(signal.size() - pendingZeros);
+        return signal;
+    }
+
+    Signal flush()
+    {
+        Signal signal(pendingZeros, 0);
+        pendingZeros = 0;
+        lastPulse = 1;
+        return signal;
+    }
+
+private:
+    size_t pendingZeros;
+    int8_t lastPulse;
+};
+
+class Hdb3Scrambler
+{
+public:
+    Hdb3Scrambler() : pendingZeros(0), lastPulse(1), pulseCount(0) {}
+
+    Signal push(const Signal &chunk)
+    {
+        Signal signal(pendingZeros, 0);
+        signal.insert(signal.end(), chunk.begin(), chunk.end());
+        pendingZeros = LineEncoder::scrambleHDB3InPlace(signal.data(), signal.size(), lastPulse, pulseCount);
+        signal.resize(signal.size() - pendingZeros);
+        return signal;
+    }
+
+    Signal flush()
+    {
+        Signal signal(pendingZeros, 0);
+        pendingZeros = 0;
+        lastPulse = 1;
+        pulseCount = 0;
+        return signal;
+    }
+
+private:
+    size_t pendingZeros;
+    int8_t lastPulse;
+    int pulseCount;
+};
+
+// AMI followed by a streaming scrambler.
+template <class Scrambler>
+class ScrambledAmiEncoder
+{
+public:
+    Signal push(const BitStream &chunk)
+    {
+        return scrambler.push(ami.push(chunk));
+    }
+
+    Signal flush()
+    {
+        ami.flush();
+        return scrambler.flush();
+    }
+
+private:
+    AmiEncoder ami;
+    Scrambler scrambler;
+};
+
+typedef ScrambledAmiEncoder<B8zsScrambler> B8zsEncoder;
+typedef ScrambledAmiEncoder<Hdb3Scrambler> Hdb3Encoder;
+
+// ==================== PULSE SHAPING ====================
+
+enum class PulseShape
+{
+    Rectangular,
+    RaisedCosine,
+    Gaussian
+};
+
+// Pulses peak on the symbol instant, output sample i * samplesPerSymbol for symbol i once
+// the filter delay is removed, for odd and even samplesPerSymbol alike. Rectangular pulses
+// hold the level from there to the next instant.
+struct PulseFormat
+{
+    PulseShape shape = PulseShape::RaisedCosine;
+    int samplesPerSymbol = 8;
+    int spanSymbols = 8;        // filter length in symbols; rectangular pulses use 1
+    double rolloff = 0.35;      // raised cosine excess bandwidth
+    double bandwidthTime = 0.5; // Gaussian BT product
+
+    static const PulseFormat &checked(const PulseFormat &format)
+    {
+        if (format.samplesPerSymbol < 1)
+            throw invalid_argument("Pulse shaping needs at least one sample per symbol");
+        return format;
+    }
+};
+
+// Upsamples line-code levels into a float waveform through a polyphase FIR. Row k of the
+// coefficient table holds the taps that symbol n - k contributes to each of the
+// samplesPerSymbol outputs of symbol n, so every output symbol is a sum of rows scaled
+// by one input level, a broadcast multiply-accumulate eight phases at a time. push()
+// keeps the last spanSymbols - 1 levels, so a stream can be rendered chunk by chunk.
+class PulseShaper
+{
+public:
+    explicit PulseShaper(const PulseFormat &format = PulseFormat())
+        : samplesPerSymbol(PulseFormat::checked(format).samplesPerSymbol),
+          span(format.shape == PulseShape::Rectangular ? 1 : max(2, format.spanSymbols & ~1)),
+          width((format.samplesPerSymbol + 7) & ~7),
+          coefficients(span * width, 0.0f), history(span - 1, 0.0f)
+    {
+        for (int k = 0; k < span; k++)
+        {
+            for (int p = 0; p < samplesPerSymbol; p++)
+            {
+                double t = k + (double)p / samplesPerSymbol - span / 2;
+                coefficients[k * width + p] = (float)pulse(format, t);
+            }
+        }
+    }
+
+    // Output samples by which the waveform lags the input symbols.
+    size_t delaySamples() const { return (size_t)(span / 2) * samplesPerSymbol; }
+
+    vector<float> push(const Signal &symbols)
+    {
+        const size_t blockSymbols = 4096;
+        // Rows are stored `width` floats wide; the slack past the end absorbs the last one.
+        vector<float> waveform(symbols.size() * samplesPerSymbol + width);
+        vector<float> levels(span - 1 + min(blockSymbols, symbols.size()));
+        for (size_t first = 0; first < symbols.size(); first += blockSymbols)
+        {
+            size_t count = min(blockSymbols, symbols.size() - first);
+            copy(history.begin(), history.end(), levels.begin());
+            for (size_t i = 0; i < count; i++)
+            {
+                levels[span - 1 + i] = symbols[first + i];
+            }
+            render(levels.data() + span - 1, count, waveform.data() + first * samplesPerSymbol);
+            copy(levels.begin() + count, levels.begin() + count + span - 1, history.begin());
+        }
+        waveform.resize(symbols.size() * samplesPerSymbol);
+        return waveform;
+    }
+
+    // Drains the filter by pushing zero levels, then resets it for the next stream.
+    vector<float> flush()
+    {
+        vector<float> tail = push(Signal(span - 1, 0));
+        fill(history.begin(), history.end(), 0.0f);
+        return tail;
+    }
+
+    // One-shot rendering aligned to the input: samplesPerSymbol samples per symbol.
+    static vector<float> shape(const Signal &symbols, const PulseFormat &format = PulseFormat())
+    {
+        PulseShaper shaper(format);
+        vector<float> waveform = shaper.push(symbols);
+        vector<float> tail = shaper.flush();
+        waveform.insert(waveform.end(), tail.begin(), tail.end());
+        waveform.erase(waveform.begin(), waveform.begin() + shaper.delaySamples());
+        waveform.resize(symbols.size() * format.samplesPerSymbol);
+        return waveform;
+    }
+
+private:
+    int samplesPerSymbol;
+    int span;
+    int width;
+    vector<float> coefficients;
+    vector<float> history;
+
+    // t in symbol periods from the symbol instant.
+    static double pulse(const PulseFormat &format, double t)
+    {
+        switch (format.shape)
+        {
+        case PulseShape::Rectangular:
+            return (t >= 0 && t < 1) ? 1.0 : 0.0;
+        case PulseShape::RaisedCosine:
+        {
+            double sinc = (t == 0) ? 1.0 : sin(M_PI * t) / (M_PI * t);
+            double edge = 2 * format.rolloff * t;
+            if (fabs(fabs(edge) - 1.0) < 1e-9)
+                return M_PI / 4 * sinc;
+            return sinc * cos(M_PI * format.rolloff * t) / (1.0 - edge * edge);
+        }
+        case PulseShape::Gaussian:
+        {
+            // A rectangular symbol through a Gaussian filter, so a constant level stays put.
+            double c = M_PI * format.bandwidthTime * sqrt(2.0 / log(2.0));
+            return 0.5 * (erf(c * (t + 0.5)) - erf(c * (t - 0.5)));
+        }
+        }
+        return 0;
+    }
+
+    // levels[-(span - 1)] .. levels[count - 1] are valid; writes `width` floats per symbol.
+    void render(const float *levels, size_t count, float *out) const
+    {
+#ifdef SIGNAL_X86_KERNELS
+        if (LevelKernels::hasAVX2())
+        {
+            renderAVX2(levels, count, out);
+            return;
+        }
+#endif
+        for (size_t n = 0; n < count; n++)
+        {
+            float *row = out + n * samplesPerSymbol;
+            fill_n(row, width, 0.0f);
+            for (int k = 0; k < span; k++)
+            {
+                float level = levels[(ptrdiff_t)n - k];
+                if (level == 0)
+                    continue;
+                const float *taps = coefficients.data() + k * width;
+                for (int p = 0; p < width; p++)
+                {
+                    row[p] += level * taps[p];
+                }
+            }
+        }
+    }
+
+#ifdef SIGNAL_X86_KERNELS
+    __attribute__((target("avx2"))) void renderAVX2(const float *levels, size_t count, float *out) const
+    {
+        for (size_t n = 0; n < count; n++)
+        {
+            float *row = out + n * samplesPerSymbol;
+            for (int p = 0; p < width; p += 8)
+            {
+                __m256 sum = _mm256_setzero_ps();
+                for (int k = 0; k < span; k++)
+                {
+                    __m256 taps = _mm256_loadu_ps(coefficients.data() + k * width + p);
+                    sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(levels[(ptrdiff_t)n - k]), taps));
+                }
+                _mm256_storeu_ps(row + p, sum);
+            }
+        }
+    }
+#endif
+};
+
+// ==================== SIMD SAMPLE KERNELS ====================
+
+// G.711 expansion tables, generated at compile time: code byte -> 16-bit linear sample.
+struct CompandingTables
+{
+    int16_t muLaw[256];
+    int16_t aLaw[256];
+};
+
+constexpr CompandingTables makeCompandingTables()
+{
+    CompandingTables t{};
+    for (unsigned code = 0; code < 256; code++)
+    {
+        unsigned u = ~code & 0xFF;
+        int magnitude = ((((u & 0x0F) << 3) + 0x84) << ((u & 0x70) >> 4)) - 0x84;
+        t.muLaw[code] = (u & 0x80) ? -magnitude : magnitude;
+
+        unsigned a = code ^ 0x55;
+        unsigned segment = (a & 0x70) >> 4;
+        int value = (a & 0x0F) << 4;
+        if (segment == 0)
+            value += 8;
+        else
+            value = (value + 0x108) << (segment - 1);
+        t.aLaw[code] = (a & 0x80) ? value : -value;
+    }
+    return t;
+}
+
+// Delta modulation steps: entry [b][j] is the net count of up steps over bits 0..j of
+// byte b, each 1 counting +1 and each 0 counting -1.
+struct DeltaStepTables
+{
+    int8_t steps[256][8];
+};
+
+constexpr DeltaStepTables makeDeltaStepTables()
+{
+    DeltaStepTables t{};
+    for (unsigned byte = 0; byte < 256; byte++)
+    {
+        int level = 0;
+        for (int j = 0; j < 8; j++)
+        {
+            level += ((byte >> j) & 1) ? 1 : -1;
+            t.steps[byte][j] = (int8_t)level;
+        }
+    }
+    return t;
+}
+
+// Kernels over analog samples, dispatched like LevelKernels: AVX2 takes four doubles per
+// iteration and the scalar loop finishes whatever is left.
+class SampleKernels
+{
+public:
+    // One pass for both ends of the range. n must be at least 1.
+    static void minMax(const double *samples, size_t n, double &minVal, double &maxVal)
+    {
+        size_t done = 1;
+        minVal = maxVal = samples[0];
+#ifdef SIGNAL_X86_KERNELS
+        if (LevelKernels::hasAVX2() && n >= 4)
+            done = minMaxAVX2(samples, n, minVal, maxVal);
+#endif
+        for (size_t i = done; i < n; i++)
+        {
+            minVal = min(minVal, samples[i]);
+            maxVal = max(maxVal, samples[i]);
+        }
+    }
+
+    // Uniform quantizer: (sample - minVal) / step truncated and clamped to [0, maxCode].
+    // It divides rather than multiplying by 1 / step so that samples on a level boundary
+    // land on the same code either way; a zero step (no range) gives code 0.
+    static void quantize(const double *samples, size_t n, double minVal, double step, uint32_t maxCode, uint32_t *codes)
+    {
+        size_t done = 0;
+#ifdef SIGNAL_X86_KERNELS
+        // The AVX2 conversion is signed, so 32-bit codes take the scalar loop.
+        if (LevelKernels::hasAVX2() && maxCode <= 0x7FFFFFFF)
+            done = quantizeAVX2(samples, n, minVal, step, maxCode, codes);
+#endif
+        for (size_t i = done; i < n; i++)
+        {
+            double level = (samples[i] - minVal) / step;
+            level = level > 0 ? level : 0;
+            codes[i] = (uint32_t)min(level, (double)maxCode);
+        }
+    }
+
+    // G.711 compression of 16-bit linear samples. The segment is the position of the
+    // magnitude's top bit, found with count-leading-zeros here and from the exponent of
+    // an int-to-float conversion in the AVX2 path, so neither branches per sample.
+    // mu-law works on the top 14 bits. Clipping the magnitude at 8158 gives the top code
+    // of segment 7, which is where G.711 saturates.
+    static uint8_t muLaw(int16_t sample)
+    {
+        int value = sample >> 2;
+        int mask = (value < 0) ? 0x7F : 0xFF;
+        int magnitude = min(abs(value), 8158) + 0x21;
+        int segment = 63 - LevelKernels::countLeadingZeros(magnitude) - 5;
+        int mantissa = (magnitude >> (segment + 1)) & 0x0F;
+        return (segment << 4 | mantissa) ^ mask;
+    }
+
+    // A-law works on the top 13 bits, which never reach past segment 7.
+    static uint8_t aLaw(int16_t sample)
+    {
+        int value = sample >> 3;
+        int mask = (value < 0) ? 0x55 : 0xD5;
+        value = (value < 0) ? ~value : value;
+        int segment = (value > 0x1F) ? 63 - LevelKernels::countLeadingZeros(value) - 4 : 0;
+        int mantissa = (value >> max(segment, 1)) & 0x0F;
+        return (segment << 4 | mantissa) ^ mask;
+    }
+
+    static void encodeMuLaw(const int16_t *samples, size_t n, uint8_t *codes)
+    {
+        size_t done = 0;
+#ifdef SIGNAL_X86_KERNELS
+        if (LevelKernels::hasAVX2())
+            done = encodeMuLawAVX2(samples, n, codes);
+#endif
+        for (size_t i = done; i < n; i++)
+        {
+            codes[i] = muLaw(samples[i]);
+        }
+    }
+
+    static void encodeALaw(const int16_t *samples, size_t n, uint8_t *codes)
+    {
+        size_t done = 0;
+#ifdef SIGNAL_X86_KERNELS
+        if (LevelKernels::hasAVX2())
+            done = encodeALawAVX2(samples, n, codes);
+#endif
+        for (size_t i = done; i < n; i++)
+        {
+            codes[i] = aLaw(samples[i]);
+        }
+    }
+
+    static const CompandingTables &companding()
+    {
+        static constexpr CompandingTables t = makeCompandingTables();
+        return t;
+    }
+
+    // Appends each code as a `bits`-wide codeword, most significant bit first. Codewords
+    // are gathered into a word before they go to the stream.
+    template <class Code>
+    static void packCodewords(const Code *codes, size_t n, int bits, BitStream &out)
+    {
+        uint64_t pending = 0;
+        int fill = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            uint64_t codeword = reverse32(codes[i]) >> (32 - bits);
+            pending |= codeword << fill;
+            fill += bits;
+            if (fill >= 64)
+            {
+                out.appendBits(pending, 64);
+                fill -= 64;
+                pending = fill ? codeword >> (bits - fill) : 0;
+            }
+        }
+        out.appendBits(pending, fill);
+    }
+
+    // Inverse of packCodewords: n codewords of `bits` bits starting at bit `pos`.
+    static void unpackCodewords(const BitStream &in, size_t pos, size_t n, int bits, uint32_t *codes)
+    {
+        for (size_t i = 0; i < n; i++, pos += bits)
+        {
+            codes[i] = reverse32((uint32_t)in.getBits(pos, bits)) >> (32 - bits);
+        }
+    }
+
+    // Mid-interval reconstruction, the inverse of quantize().
+    static void reconstruct(const uint32_t *codes, size_t n, double minVal, double step, double *samples)
+    {
+        size_t done = 0;
+#ifdef SIGNAL_X86_KERNELS
+        if (LevelKernels::hasAVX2())
+            done = reconstructAVX2(codes, n, minVal, step, samples);
+#endif
+        for (size_t i = done; i < n; i++)
+        {
+            samples[i] = minVal + (codes[i] + 0.5) * step;
+        }
+    }
+
+    // Delta modulation integrator as a prefix sum: sample j is start plus delta times the
+    // net up steps through bit j, read a byte at a time from the step table. Returns the
+    // level after the last bit. numBits must be a multiple of 8 except on the final call.
+    static double integrateDelta(const uint64_t *words, size_t numBits, double start, double delta, double *samples)
+    {
+        int64_t level = 0;
+        size_t i = 0;
+#ifdef SIGNAL_X86_KERNELS
+        if (LevelKernels::hasAVX2())
+            i = integrateDeltaAVX2(words, numBits, start, delta, samples, level);
+#endif
+        for (; i + 8 <= numBits; i += 8)
+        {
+            const int8_t *steps = deltaSteps().steps[(words[i >> 6] >> (i & 63)) & 0xFF];
+            for (int j = 0; j < 8; j++)
+            {
+                samples[i + j] = start + delta * (level + steps[j]);
+            }
+            level += steps[7];
+        }
+        for (; i < numBits; i++)
+        {
+            level += ((words[i >> 6] >> (i & 63)) & 1) ? 1 : -1;
+            samples[i] = start + delta * level;
+        }
+        return start + delta * level;
+    }
+
+    // Sums of reference^2 and (reference - decoded)^2, added to the running totals.
+    static void accumulateError(const double *reference, const double *decoded, size_t n, double &signalSum, double &errorSum)
+    {
+        size_t done = 0;
+#ifdef SIGNAL_X86_KERNELS
+        if (LevelKernels::hasAVX2())
+            done = accumulateErrorAVX2(reference, decoded, n, signalSum, errorSum);
+#endif
+        for (size_t i = done; i < n; i++)
+        {
+            double error = reference[i] - decoded[i];
+            signalSum += reference[i] * reference[i];
+            errorSum += error * error;
+        }
+    }
+
+    static const DeltaStepTables &deltaSteps()
+    {
+        static constexpr DeltaStepTables table = makeDeltaStepTables();
+        return table;
+    }
+
+    static uint32_t reverse32(uint32_t x)
+    {
+        x = ((x >> 1) & 0x55555555) | ((x & 0x55555555) << 1);
+        x = ((x >> 2) & 0x33333333) | ((x & 0x33333333) << 2);
+        x = ((x >> 4) & 0x0F0F0F0F) | ((x & 0x0F0F0F0F) << 4);
+        x = ((x >> 8) & 0x00FF00FF) | ((x & 0x00FF00FF) << 8);
+        return (x >> 16) | (x << 16);
+    }
+
+private:
+#ifdef SIGNAL_X86_KERNELS
+    __attribute__((target("avx2"))) static size_t minMaxAVX2(const double *samples, size_t n, double &minVal, double &maxVal)
+    {
+        __m256d lo = _mm256_loadu_pd(samples);
+        __m256d hi = lo;
+        size_t i = 4;
+        for (; i + 4 <= n; i += 4)
+        {
+            __m256d x = _mm256_loadu_pd(samples + i);
+            lo = _mm256_min_pd(lo, x);
+            hi = _mm256_max_pd(hi, x);
+        }
+        double los[4], his[4];
+        _mm256_storeu_pd(los, lo);
+        _mm256_storeu_pd(his, hi);
+        minVal = min(min(los[0], los[1]), min(los[2], los[3]));
+        maxVal = max(max(his[0], his[1]), max(his[2], his[3]));
+        return i;
+    }
+
+    __attribute__((target("avx2"))) static size_t quantizeAVX2(const double *samples, size_t n, double minVal, double step, uint32_t maxCode, uint32_t *codes)
+    {
+        const __m256d offset = _mm256_set1_pd(minVal);
+        const __m256d divisor = _mm256_set1_pd(step);
+        const __m256d zero = _mm256_setzero_pd();
+        const __m256d top = _mm256_set1_pd((double)maxCode);
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            __m256d level = _mm256_div_pd(_mm256_sub_pd(_mm256_loadu_pd(samples + i), offset), divisor);
+            // max(level, 0) returns 0 for NaN, as the scalar comparison does.
+            level = _mm256_min_pd(_mm256_max_pd(level, zero), top);
+            _mm_storeu_si128((__m128i *)(codes + i), _mm256_cvttpd_epi32(level));
+        }
+        return i;
+    }
+
+    // AVX2 converts only signed integers, so codes are biased by 2^31 and the bias added back.
+    __attribute__((target("avx2"))) static size_t reconstructAVX2(const uint32_t *codes, size_t n, double minVal, double step, double *samples)
+    {
+        const __m128i bias = _mm_set1_epi32((int)0x80000000);
+        const __m256d offset = _mm256_set1_pd(2147483648.0 + 0.5);
+        const __m256d base = _mm256_set1_pd(minVal);
+        const __m256d scale = _mm256_set1_pd(step);
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            __m128i code = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(codes + i)), bias);
+            __m256d level = _mm256_add_pd(_mm256_cvtepi32_pd(code), offset);
+            _mm256_storeu_pd(samples + i, _mm256_add_pd(base, _mm256_mul_pd(level, scale)));
+        }
+        return i;
+    }
+
+    __attribute__((target("avx2"))) static size_t integrateDeltaAVX2(const uint64_t *words, size_t numBits, double start, double delta,
+                                                                     double *samples, int64_t &level)
+    {
+        const __m256d origin = _mm256_set1_pd(start);
+        const __m256d scale = _mm256_set1_pd(delta);
+        size_t i = 0;
+        for (; i + 8 <= numBits; i += 8)
+        {
+            const int8_t *steps = deltaSteps().steps[(words[i >> 6] >> (i & 63)) & 0xFF];
+            __m256i counts = _mm256_add_epi32(_mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i *)steps)), _mm256_set1_epi32((int)level));
+            __m256d low = _mm256_cvtepi32_pd(_mm256_castsi256_si128(counts));
+            __m256d high = _mm256_cvtepi32_pd(_mm256_extracti128_si256(counts, 1));
+            _mm256_storeu_pd(samples + i, _mm256_add_pd(origin, _mm256_mul_pd(low, scale)));
+            _mm256_storeu_pd(samples + i + 4, _mm256_add_pd(origin, _mm256_mul_pd(high, scale)));
+            level += steps[7];
+        }
+        return i;
+    }
+
+    __attribute__((target("avx2"))) static size_t accumulateErrorAVX2(const double *reference, const double *decoded, size_t n, double &signalSum, double &errorSum)
+    {
+        __m256d signal = _mm256_setzero_pd();
+        __m256d noise = _mm256_setzero_pd();
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            __m256d x = _mm256_loadu_pd(reference + i);
+            __m256d error = _mm256_sub_pd(x, _mm256_loadu_pd(decoded + i));
+            signal = _mm256_add_pd(signal, _mm256_mul_pd(x, x));
+            noise = _mm256_add_pd(noise, _mm256_mul_pd(error, error));
+        }
+        double signals[4], noises[4];
+        _mm256_storeu_pd(signals, signal);
+        _mm256_storeu_pd(noises, noise);
+        signalSum += (signals[0] + signals[1]) + (signals[2] + signals[3]);
+        errorSum += (noises[0] + noises[1]) + (noises[2] + noises[3]);
+        return i;
+    }
+
+    // floor(log2(x)) for 0 < x < 2^24, read off the float exponent.
+    __attribute__((target("avx2"))) static __m256i log2AVX2(__m256i x)
+    {
+        __m256i bits = _mm256_castps_si256(_mm256_cvtepi32_ps(x));
+        return _mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127));
+    }
+
+    __attribute__((target("avx2"))) static void storeBytesAVX2(__m256i values, uint8_t *out)
+    {
+        __m128i words = _mm_packus_epi32(_mm256_castsi256_si128(values), _mm256_extracti128_si256(values, 1));
+        _mm_storel_epi64((__m128i *)out, _mm_packus_epi16(words, words));
+    }
+
+    __attribute__((target("avx2"))) static size_t encodeMuLawAVX2(const int16_t *samples, size_t n, uint8_t *codes)
+    {
+        const __m256i positiveMask = _mm256_set1_epi32(0xFF);
+        const __m256i signBit = _mm256_set1_epi32(0x80);
+        const __m256i clip = _mm256_set1_epi32(8158);
+        const __m256i bias = _mm256_set1_epi32(0x21);
+        const __m256i low4 = _mm256_set1_epi32(0x0F);
+        const __m256i one = _mm256_set1_epi32(1);
+        const __m256i five = _mm256_set1_epi32(5);
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            __m256i x = _mm256_srai_epi32(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(samples + i))), 2);
+            __m256i mask = _mm256_xor_si256(positiveMask, _mm256_and_si256(_mm256_srai_epi32(x, 31), signBit));
+            __m256i magnitude = _mm256_add_epi32(_mm256_min_epi32(_mm256_abs_epi32(x), clip), bias);
+            __m256i segment = _mm256_sub_epi32(log2AVX2(magnitude), five);
+            __m256i mantissa = _mm256_and_si256(_mm256_srlv_epi32(magnitude, _mm256_add_epi32(segment, one)), low4);
+            __m256i code = _mm256_or_si256(_mm256_slli_epi32(segment, 4), mantissa);
+            storeBytesAVX2(_mm256_xor_si256(code, mask), codes + i);
+        }
+        return i;
+    }
+
+    __attribute__((target("avx2"))) static size_t encodeALawAVX2(const int16_t *samples, size_t n, uint8_t *codes)
+    {
+        const __m256i positiveMask = _mm256_set1_epi32(0xD5);
+        const __m256i signBit = _mm256_set1_epi32(0x80);
+        const __m256i low4 = _mm256_set1_epi32(0x0F);
+        const __m256i one = _mm256_set1_epi32(1);
+        const __m256i four = _mm256_set1_epi32(4);
+        const __m256i zero = _mm256_setzero_si256();
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            __m256i x = _mm256_srai_epi32(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(samples + i))), 3);
+            __m256i negative = _mm256_srai_epi32(x, 31);
+            __m256i value = _mm256_xor_si256(x, negative);
+            __m256i mask = _mm256_xor_si256(positiveMask, _mm256_and_si256(negative, signBit));
+            __m256i segment = _mm256_max_epi32(_mm256_sub_epi32(log2AVX2(_mm256_max_epi32(value, one)), four), zero);
+            __m256i mantissa = _mm256_and_si256(_mm256_srlv_epi32(value, _mm256_max_epi32(segment, one)), low4);
+            __m256i code = _mm256_or_si256(_mm256_slli_epi32(segment, 4), mantissa);
+            storeBytesAVX2(_mm256_xor_si256(code, mask), codes + i);
+        }
+        return i;
+    }
+#endif
+};
+
+// ==================== ADAPTIVE DELTA AND SIGMA-DELTA ====================
+
+// Continuously variable slope delta modulation. The step grows while the last runLength
+// bits agree, the sign of slope overload, and decays toward minStep otherwise. The
+// integrator leaks toward zero so that encoder and decoder converge after a bit error.
+struct CvsdFormat
+{
+    double minStep = 0.01;
+    double maxStep = 0.5;
+    double growth = 1.5;   // step multiplier while the bits agree
+    double decay = 0.9;    // step multiplier otherwise
+    int runLength = 3;     // agreeing bits that count as slope overload
+    double leak = 0.995;   // integrator leak per sample
+    double smoothing = 0.5; // decoder's one-pole reconstruction low-pass, 1 = none
+
+    // The run is tracked in a 32-bit history, so runLength clamps to 1 through 31.
+    int clampedRunLength() const { return max(1, min(31, runLength)); }
+};
+
+// Step and estimate tracking shared by the CVSD encoder and decoder, so both sides
+// follow exactly the same recursion.
+class CvsdIntegrator
+{
+public:
+    explicit CvsdIntegrator(const CvsdFormat &cvsdFormat)
+        : format(cvsdFormat), runMask((1u << cvsdFormat.clampedRunLength()) - 1)
+    {
+        reset();
+    }
+
+    double estimate() const { return level; }
+
+    void update(bool bit)
+    {
+        history = ((history << 1) | bit) & runMask;
+        if (history == 0 || history == runMask)
+            step = min(step * format.growth, format.maxStep);
+        else
+            step = max(step * format.decay, format.minStep);
+        level = format.leak * level + (bit ? step : -step);
+    }
+
+    void reset()
+    {
+        // Alternating history, so the first bits do not read as overload.
+        history = 0x55555555 & runMask;
+        step = format.minStep;
+        level = 0;
+    }
+
+private:
+    CvsdFormat format;
+    unsigned runMask;
+    unsigned history;
+    double step;
+    double level;
+};
+
+// Encoders gather 64 decisions into a word before appending it, and keep their state
+// across push() calls; flush() resets them for the next stream.
+class CvsdEncoder
+{
+public:
+    explicit CvsdEncoder(const CvsdFormat &format = CvsdFormat()) : integrator(format) {}
+
+    BitStream push(const double *samples, size_t n)
+    {
+        BitStream out;
+        out.reserve(n);
+        for (size_t first = 0; first < n; first += 64)
+        {
+            size_t count = min((size_t)64, n - first);
+            uint64_t word = 0;
+            for (size_t i = 0; i < count; i++)
+            {
+                bool bit = samples[first + i] >= integrator.estimate();
+                word |= (uint64_t)bit << i;
+                integrator.update(bit);
+            }
+            out.appendBits(word, (int)count);
+        }
+        return out;
+    }
+
+    BitStream push(const vector<double> &samples)
+    {
+        return push(samples.data(), samples.size());
+    }
+
+    void flush()
+    {
+        integrator.reset();
+    }
+
+private:
+    CvsdIntegrator integrator;
+};
+
+class CvsdDecoder
+{
+public:
+    explicit CvsdDecoder(const CvsdFormat &format = CvsdFormat())
+        : integrator(format), smoothing(format.smoothing), output(0) {}
+
+    vector<double> push(const BitStream &bits)
+    {
+        vector<double> samples(bits.size());
+        for (size_t i = 0; i < bits.size(); i++)
+        {
+            integrator.update(bits.get(i));
+            output += smoothing * (integrator.estimate() - output);
+            samples[i] = output;
+        }
+        return samples;
+    }
+
+    void flush()
+    {
+        integrator.reset();
+        output = 0;
+    }
+
+private:
+    CvsdIntegrator integrator;
+    double smoothing;
+    double output;
+};
+
+// First- or second-order sigma-delta: the input, within +-1, is oversampled to one bit
+// per sample whose running average follows it. The decoder reconstructs with a CIC
+// decimator of order + 1 stages, one output per `decimation` bits.
+struct SigmaDeltaFormat
+{
+    int order = 2;
+    size_t decimation = 64;
+
+    // Only first and second order are implemented; other values clamp to the nearer one.
+    int clampedOrder() const { return order >= 2 ? 2 : 1; }
+
+    // The decoder emits one sample per `decimation` bits, so zero would never emit.
+    size_t checkedDecimation() const
+    {
+        if (decimation == 0)
+            throw invalid_argument("Sigma-delta decimation must be at least 1");
+        return decimation;
+    }
+};
+
+class SigmaDeltaEncoder
+{
+public:
+    explicit SigmaDeltaEncoder(const SigmaDeltaFormat &format = SigmaDeltaFormat())
+        : order(format.clampedOrder())
+    {
+        flush();
+    }
+
+    BitStream push(const double *samples, size_t n)
+    {
+        BitStream out;
+        out.reserve(n);
+        for (size_t first = 0; first < n; first += 64)
+        {
+            size_t count = min((size_t)64, n - first);
+            uint64_t word = 0;
+            for (size_t i = 0; i < count; i++)
+            {
+                double x = max(-1.0, min(1.0, samples[first + i]));
+                first1 += x - feedback;
+                double quantizerInput = first1;
+                if (order == 2)
+                {
+                    second += first1 - feedback;
+                    quantizerInput = second;
+                }
+                bool bit = quantizerInput >= 0;
+                feedback = bit ? 1.0 : -1.0;
+                word |= (uint64_t)bit << i;
+            }
+            out.appendBits(word, (int)count);
+        }
+        return out;
+    }
+
+    BitStream push(const vector<double> &samples)
+    {
+        return push(samples.data(), samples.size());
+    }
+
+    void flush()
+    {
+        first1 = second = 0;
+        feedback = 0;
+    }
+
+private:
+    int order;
+    double first1, second, feedback;
+};
+
+class SigmaDeltaDecoder
+{
+public:
+    explicit SigmaDeltaDecoder(const SigmaDeltaFormat &format = SigmaDeltaFormat())
+        : stages(format.clampedOrder() + 1), decimation(format.checkedDecimation()),
+          gain(pow((double)decimation, stages))
+    {
+        flush();
+    }
+
+    vector<double> push(const BitStream &bits)
+    {
+        vector<double> samples;
+        samples.reserve(bits.size() / decimation + 1);
+        for (size_t i = 0; i < bits.size(); i++)
+        {
+            // The integrators wrap; the comb differences undo that exactly.
+            uint64_t x = bits.get(i) ? 1 : (uint64_t)-1;
+            for (int s = 0; s < stages; s++)
+            {
+                integrators[s] += x;
+                x = integrators[s];
+            }
+            if (++phase < decimation)
+                continue;
+            phase = 0;
+            for (int s = 0; s < stages; s++)
+            {
+                uint64_t delayed = combs[s];
+                combs[s] = x;
+                x -= delayed;
+            }
+            samples.push_back((int64_t)x / gain);
+        }
+        return samples;
+    }
+
+    void flush()
+    {
+        fill(integrators, integrators + 3, 0);
+        fill(combs, combs + 3, 0);
+        phase = 0;
+    }
+
+private:
+    int stages;
+    size_t decimation;
+    double gain;
+    uint64_t integrators[3], combs[3];
+    size_t phase;
+};
+
+// ==================== DIFFERENTIAL PCM ====================
+
+// IMA-ADPCM step sizes and the index change for each 3-bit magnitude. The steps are kept
+// 32 bits wide so that the AVX2 decoder can gather them directly.
+constexpr int32_t imaStepSizes[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767};
+
+constexpr int32_t imaIndexSteps[8] = {-1, -1, -1, -1, 2, 4, 6, 8};
+
+struct AdpcmChannel
+{
+    int32_t predictor = 0;
+    int32_t index = 0;
+};
+
+// IMA-ADPCM, 4-bit codes of 16-bit samples. Multi-channel buffers are interleaved, sample
+// f of channel c at [f * numChannels + c], with one code per byte in the same layout.
+class ImaAdpcm
+{
+public:
+    static uint8_t encodeSample(int16_t sample, AdpcmChannel &channel)
+    {
+        int32_t step = imaStepSizes[channel.index];
+        int32_t difference = sample - channel.predictor;
+        uint8_t code = 0;
+        if (difference < 0)
+        {
+            code = 8;
+            difference = -difference;
+        }
+        for (uint8_t bit = 4; bit != 0; bit >>= 1, step >>= 1)
+        {
+            if (difference >= step)
+            {
+                code |= bit;
+                difference -= step;
+            }
+        }
+        // The decoder's reconstruction becomes the next prediction on both sides.
+        decodeSample(code, channel);
+        return code;
+    }
+
+    static int16_t decodeSample(uint8_t code, AdpcmChannel &channel)
+    {
+        int32_t step = imaStepSizes[channel.index];
+        int32_t difference = step >> 3;
+        if (code & 4)
+            difference += step;
+        if (code & 2)
+            difference += step >> 1;
+        if (code & 1)
+            difference += step >> 2;
+        channel.predictor += (code & 8) ? -difference : difference;
+        channel.predictor = max(-32768, min(32767, channel.predictor));
+        channel.index = max(0, min(88, channel.index + imaIndexSteps[code & 7]));
+        return (int16_t)channel.predictor;
+    }
+
+    static void encode(const int16_t *samples, size_t numFrames, vector<AdpcmChannel> &channels, uint8_t *codes)
+    {
+        size_t numChannels = channels.size();
+        for (size_t i = 0; i < numFrames * numChannels; i++)
+        {
+            codes[i] = encodeSample(samples[i], channels[i % numChannels]);
+        }
+    }
+
+    // Channels are independent, so each group of eight decodes in the lanes of one AVX2
+    // register and the groups are spread over the pool.
+    static void decode(const uint8_t *codes, size_t numFrames, vector<AdpcmChannel> &channels, int16_t *samples,
+                       ThreadPool &pool = ThreadPool::shared())
+    {
+        const size_t lanes = 8;
+        size_t numChannels = channels.size();
+        size_t numGroups = (numChannels + lanes - 1) / lanes;
+        auto decodeGroup = [&](size_t g)
+        {
+            size_t first = g * lanes;
+            size_t count = min(lanes, numChannels - first);
+#ifdef SIGNAL_X86_KERNELS
+            if (count == lanes && LevelKernels::hasAVX2())
+            {
+                decodeLanesAVX2(codes + first, numFrames, numChannels, channels.data() + first, samples + first);
+                return;
+            }
+#endif
+            for (size_t c = first; c < first + count; c++)
+            {
+                for (size_t f = 0; f < numFrames; f++)
+                {
+                    samples[f * numChannels + c] = decodeSample(codes[f * numChannels + c], channels[c]);
+                }
+            }
+        };
+        if (numGroups == 1)
+            decodeGroup(0);
+        else
+            pool.run(numGroups, decodeGroup);
+    }
+
+private:
+#ifdef SIGNAL_X86_KERNELS
+    __attribute__((target("avx2"))) static void decodeLanesAVX2(const uint8_t *codes, size_t numFrames, size_t stride,
+                                                                AdpcmChannel *channels, int16_t *samples)
+    {
+        int32_t predictors[8], indices[8];
+        for (int lane = 0; lane < 8; lane++)
+        {
+            predictors[lane] = channels[lane].predictor;
+            indices[lane] = channels[lane].index;
+        }
+        __m256i predictor = _mm256_loadu_si256((const __m256i *)predictors);
+        __m256i index = _mm256_loadu_si256((const __m256i *)indices);
+
+        const __m256i indexSteps = _mm256_loadu_si256((const __m256i *)imaIndexSteps);
+        const __m256i bit1 = _mm256_set1_epi32(1);
+        const __m256i bit2 = _mm256_set1_epi32(2);
+        const __m256i bit4 = _mm256_set1_epi32(4);
+        const __m256i bit8 = _mm256_set1_epi32(8);
+        const __m256i low = _mm256_set1_epi32(-32768);
+        const __m256i high = _mm256_set1_epi32(32767);
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i lastIndex = _mm256_set1_epi32(88);
+        for (size_t f = 0; f < numFrames; f++)
+        {
+            __m256i code = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(codes + f * stride)));
+            __m256i step = _mm256_i32gather_epi32(imaStepSizes, index, 4);
+            __m256i difference = _mm256_srai_epi32(step, 3);
+            difference = _mm256_add_epi32(difference, _mm256_and_si256(step, _mm256_cmpeq_epi32(_mm256_and_si256(code, bit4), bit4)));
+            difference = _mm256_add_epi32(difference, _mm256_and_si256(_mm256_srai_epi32(step, 1), _mm256_cmpeq_epi32(_mm256_and_si256(code, bit2), bit2)));
+            difference = _mm256_add_epi32(difference, _mm256_and_si256(_mm256_srai_epi32(step, 2), _mm256_cmpeq_epi32(_mm256_and_si256(code, bit1), bit1)));
+            __m256i negative = _mm256_cmpeq_epi32(_mm256_and_si256(code, bit8), bit8);
+            difference = _mm256_sub_epi32(_mm256_xor_si256(difference, negative), negative);
+            predictor = _mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(predictor, difference), low), high);
+            index = _mm256_add_epi32(index, _mm256_permutevar8x32_epi32(indexSteps, code));
+            index = _mm256_min_epi32(_mm256_max_epi32(index, zero), lastIndex);
+
+            __m128i packed = _mm_packs_epi32(_mm256_castsi256_si128(predictor), _mm256_extracti128_si256(predictor, 1));
+            _mm_storeu_si128((__m128i *)(samples + f * stride), packed);
+        }
+
+        _mm256_storeu_si256((__m256i *)predictors, predictor);
+        _mm256_storeu_si256((__m256i *)indices, index);
+        for (int lane = 0; lane < 8; lane++)
+        {
+            channels[lane].predictor = predictors[lane];
+            channels[lane].index = indices[lane];
+        }
+    }
+#endif
+};
+
+// ==================== ANALOG SOURCES ====================
+
+// Test signals for the modulators. Frequencies are in cycles per sample (f / fs) and each
+// source continues where the last fill() stopped, so a stream can be produced block by
+// block straight into Modulator or StreamingPcmEncoder input.
+
+// Phase as a 64-bit fraction of a cycle: the frequency is exact and the phase never
+// drifts, however long the source runs.
+struct PhaseAccumulator
+{
+    uint64_t phase;
+    uint64_t increment;
+
+    PhaseAccumulator(double frequency, double initialPhase = 0)
+        : phase(toFixed(initialPhase)), increment(toFixed(frequency)) {}
+
+    double radians() const { return phase * (2 * M_PI / 18446744073709551616.0); }
+    double radiansPerSample() const { return increment * (2 * M_PI / 18446744073709551616.0); }
+
+    void advance(size_t samples) { phase += increment * (uint64_t)samples; }
+
+    static uint64_t toFixed(double cycles)
+    {
+        double fraction = ldexp(cycles - floor(cycles), 64);
+        return fraction < 18446744073709551616.0 ? (uint64_t)fraction : 0;
+    }
+};
+
+class SourceKernels
+{
+public:
+    static const size_t blockSamples = 1024;
+
+    // out[i] (+)= amplitude * sin(phase + omega * i + sweep * i * i / 2), for n up to
+    // blockSamples. Four lanes each run a complex rotation seeded with sin/cos, which
+    // keeps the rounding error of the recurrence small over one block.
+    static void rotate(double *out, size_t n, double phase, double omega, double sweep, double amplitude, bool accumulate)
+    {
+        double re[4], im[4], stepRe[4], stepIm[4];
+        for (int k = 0; k < 4; k++)
+        {
+            double theta = phase + omega * k + 0.5 * sweep * k * k;
+            re[k] = amplitude * cos(theta);
+            im[k] = amplitude * sin(theta);
+            double delta = 4 * omega + 4 * sweep * k + 8 * sweep;
+            stepRe[k] = cos(delta);
+            stepIm[k] = sin(delta);
+        }
+        double sweepRe = cos(16 * sweep), sweepIm = sin(16 * sweep);
+
+        size_t done = 0;
+#ifdef SIGNAL_X86_KERNELS
+        if (LevelKernels::hasAVX2())
+            done = rotateAVX2(out, n, re, im, stepRe, stepIm, sweepRe, sweepIm, accumulate);
+#endif
+        for (size_t i = done; i < n; i += 4)
+        {
+            for (size_t k = 0; k < 4 && i + k < n; k++)
+            {
+                out[i + k] = accumulate ? out[i + k] + im[k] : im[k];
+            }
+            for (int k = 0; k < 4; k++)
+            {
+                double r = re[k] * stepRe[k] - im[k] * stepIm[k];
+                im[k] = re[k] * stepIm[k] + im[k] * stepRe[k];
+                re[k] = r;
+                double s = stepRe[k] * sweepRe - stepIm[k] * sweepIm;
+                stepIm[k] = stepRe[k] * sweepIm + stepIm[k] * sweepRe;
+                stepRe[k] = s;
+            }
+        }
+    }
+
+private:
+#ifdef SIGNAL_X86_KERNELS
+    // Leaves the lane state at the first sample it did not write, for the scalar tail.
+    __attribute__((target("avx2"))) static size_t rotateAVX2(double *out, size_t n, double *re, double *im,
+                                                             double *stepRe, double *stepIm, double sweepRe, double sweepIm, bool accumulate)
+    {
+        __m256d zr = _mm256_loadu_pd(re), zi = _mm256_loadu_pd(im);
+        __m256d wr = _mm256_loadu_pd(stepRe), wi = _mm256_loadu_pd(stepIm);
+        const __m256d rr = _mm256_set1_pd(sweepRe), ri = _mm256_set1_pd(sweepIm);
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            _mm256_storeu_pd(out + i, accumulate ? _mm256_add_pd(_mm256_loadu_pd(out + i), zi) : zi);
+            __m256d r = _mm256_sub_pd(_mm256_mul_pd(zr, wr), _mm256_mul_pd(zi, wi));
+            zi = _mm256_add_pd(_mm256_mul_pd(zr, wi), _mm256_mul_pd(zi, wr));
+            zr = r;
+            __m256d s = _mm256_sub_pd(_mm256_mul_pd(wr, rr), _mm256_mul_pd(wi, ri));
+            wi = _mm256_add_pd(_mm256_mul_pd(wr, ri), _mm256_mul_pd(wi, rr));
+            wr = s;
+        }
+        _mm256_storeu_pd(re, zr);
+        _mm256_storeu_pd(im, zi);
+        _mm256_storeu_pd(stepRe, wr);
+        _mm256_storeu_pd(stepIm, wi);
+        return i;
+    }
+#endif
+};
+
+const size_t SourceKernels::blockSamples;
+
+template <class Source>
+class AnalogSource
+{
+public:
+    vector<double> generate(size_t n)
+    {
+        vector<double> samples(n);
+        static_cast<Source *>(this)->fill(samples.data(), n);
+        return samples;
+    }
+};
+
+class SineSource : public AnalogSource<SineSource>
+{
+public:
+    SineSource(double frequency, double peak = 1.0, double phase = 0)
+        : accumulator(frequency, phase), amplitude(peak) {}
+
+    void fill(double *out, size_t n)
+    {
+        for (size_t first = 0; first < n; first += SourceKernels::blockSamples)
+        {
+            size_t count = min(SourceKernels::blockSamples, n - first);
+            SourceKernels::rotate(out + first, count, accumulator.radians(), accumulator.radiansPerSample(), 0, amplitude, false);
+            accumulator.advance(count);
+        }
+    }
+
+private:
+    PhaseAccumulator accumulator;
+    double amplitude;
+};
+
+struct Tone
+{
+    double frequency;
+    double amplitude;
+    double phase;
+};
+
+class MultiToneSource : public AnalogSource<MultiToneSource>
+{
+public:
+    explicit MultiToneSource(const vector<Tone> &tones)
+    {
+        for (const Tone &tone : tones)
+        {
+            accumulators.push_back(PhaseAccumulator(tone.frequency, tone.phase));
+            amplitudes.push_back(tone.amplitude);
+        }
+    }
+
+    // Each block is summed tone by tone while it is still in cache.
+    void fill(double *out, size_t n)
+    {
+        for (size_t first = 0; first < n; first += SourceKernels::blockSamples)
+        {
+            size_t count = min(SourceKernels::blockSamples, n - first);
+            fill_n(out + first, count, 0.0);
+            for (size_t t = 0; t < accumulators.size(); t++)
+            {
+                SourceKernels::rotate(out + first, count, accumulators[t].radians(), accumulators[t].radiansPerSample(), 0, amplitudes[t], true);
+                accumulators[t].advance(count);
+            }
+        }
+    }
+
+private:
+    vector<PhaseAccumulator> accumulators;
+    vector<double> amplitudes;
+};
+
+// Linear sweep from fromFrequency to toFrequency over sweepLength samples, then again from
+// the start with the phase kept continuous.
+class ChirpSource : public AnalogSource<ChirpSource>
+{
+public:
+    ChirpSource(double fromFrequency, double toFrequency, size_t sweepLength, double peak = 1.0)
+        : startFrequency(fromFrequency), rate((toFrequency - fromFrequency) / checkedLength(sweepLength)),
+          sweepSamples(sweepLength), amplitude(peak), position(0), sweepPhase(0) {}
+
+    void fill(double *out, size_t n)
+    {
+        size_t first = 0;
+        while (first < n)
+        {
+            size_t count = min(min(SourceKernels::blockSamples, n - first), sweepSamples - position);
+            double t = (double)position;
+            double cycles = sweepPhase + cyclesAt(t);
+            SourceKernels::rotate(out + first, count, 2 * M_PI * (cycles - floor(cycles)),
+                                  2 * M_PI * (startFrequency + rate * t), 2 * M_PI * rate, amplitude, false);
+            first += count;
+            position += count;
+            if (position == sweepSamples)
+            {
+                double end = sweepPhase + cyclesAt((double)sweepSamples);
+                sweepPhase = end - floor(end);
+                position = 0;
+            }
+        }
+    }
+
+private:
+    double startFrequency;
+    double rate;
+    size_t sweepSamples;
+    double amplitude;
+    size_t position;
+    double sweepPhase;
+
+    double cyclesAt(double t) const
+    {
+        double cycles = startFrequency * t + 0.5 * rate * t * t;
+        return cycles - floor(cycles);
+    }
+
+    // An empty sweep has no rate and fill() would never advance.
+    static size_t checkedLength(size_t sweepLength)
+    {
+        if (sweepLength == 0)
+            throw invalid_argument("Chirp sweep must span at least one sample");
+        return sweepLength;
+    }
+};
+
+// Square wave high for the first `duty` of each cycle. Duty is clamped to [0, 1]; 1 is constant high.
+class SquareSource : public AnalogSource<SquareSource>
+{
+public:
+    SquareSource(double frequency, double peak = 1.0, double duty = 0.5)
+        : accumulator(frequency), amplitude(peak),
+          threshold(PhaseAccumulator::toFixed(min(max(duty, 0.0), 1.0))), alwaysHigh(duty >= 1.0) {}
+
+    void fill(double *out, size_t n)
+    {
+        uint64_t phase = accumulator.phase;
+        for (size_t i = 0; i < n; i++, phase += accumulator.increment)
+        {
+            out[i] = phase < threshold || alwaysHigh ? amplitude : -amplitude;
+        }
+        accumulator.phase = phase;
+    }
+
+private:
+    PhaseAccumulator accumulator;
+    double amplitude;
+    uint64_t threshold;
+    bool alwaysHigh;
+};
+
+// Sawtooth rising from -amplitude to amplitude once per cycle.
+class RampSource : public AnalogSource<RampSource>
+{
+public:
+    RampSource(double frequency, double amplitude = 1.0)
+        : accumulator(frequency), scale(amplitude / 9223372036854775808.0) {}
+
+    void fill(double *out, size_t n)
+    {
+        uint64_t phase = accumulator.phase;
+        for (size_t i = 0; i < n; i++, phase += accumulator.increment)
+        {
+            out[i] = (double)(int64_t)(phase ^ 0x8000000000000000ULL) * scale;
+        }
+        accumulator.phase = phase;
+    }
+
+private:
+    PhaseAccumulator accumulator;
+    double scale;
+};
+
+// xoshiro256+, seeded through splitmix64. Doubles take the top 52 bits as the mantissa of
+// a number in [2, 4), then subtract 3.
+class NoiseGenerator
+{
+public:
+    explicit NoiseGenerator(uint64_t seed)
+    {
+        for (uint64_t &word : state)
+        {
+            seed += 0x9E3779B97F4A7C15ULL;
+            uint64_t z = seed;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            word = z ^ (z >> 31);
+        }
+    }
+
+    uint64_t next()
+    {
+        uint64_t result = state[0] + state[3];
+        uint64_t t = state[1] << 17;
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = (state[3] << 45) | (state[3] >> 19);
+        return result;
+    }
+
+    // Uniform in [-1, 1).
+    double nextSigned()
+    {
+        uint64_t bits = (next() >> 12) | 0x4000000000000000ULL;
+        double value;
+        memcpy(&value, &bits, sizeof value);
+        return value - 3.0;
+    }
+
+private:
+    uint64_t state[4];
+};
+
+class UniformNoiseSource : public AnalogSource<UniformNoiseSource>
+{
+public:
+    UniformNoiseSource(double peak = 1.0, uint64_t seed = 1)
+        : generator(seed), amplitude(peak) {}
+
+    void fill(double *out, size_t n)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            out[i] = amplitude * generator.nextSigned();
+        }
+    }
+
+private:
+    NoiseGenerator generator;
+    double amplitude;
+};
+
+// Marsaglia's polar method: one logarithm and square root for every two samples.
+class GaussianNoiseSource : public AnalogSource<GaussianNoiseSource>
+{
+public:
+    GaussianNoiseSource(double standardDeviation = 1.0, double offset = 0, uint64_t seed = 1)
+        : generator(seed), deviation(standardDeviation), mean(offset), spare(0), hasSpare(false) {}
+
+    void fill(double *out, size_t n)
+    {
+        size_t i = 0;
+        if (hasSpare && n > 0)
+        {
+            out[i++] = spare;
+            hasSpare = false;
+        }
+        while (i < n)
+        {
+            double u, v, s;
+            do
+            {
+                u = generator.nextSigned();
+                v = generator.nextSigned();
+                s = u * u + v * v;
+            } while (s >= 1.0 || s == 0.0);
+            double factor = deviation * sqrt(-2.0 * log(s) / s);
+            out[i++] = mean + u * factor;
+            if (i < n)
+                out[i++] = mean + v * factor;
+            else
+            {
+                spare = mean + v * factor;
+                hasSpare = true;
+            }
+        }
+    }
+
+private:
+    NoiseGenerator generator;
+    double deviation;
+    double mean;
+    double spare;
+    bool hasSpare;
+};
+
+// ==================== MODULATION SCHEMES ====================
+
+// Side information that precedes a self-describing PCM stream: the codeword width as
+// 8 bits, then the input's minimum and maximum as IEEE doubles, all MSB first.
+struct PcmHeader
+{
+    int bits;
+    double minVal;
+    double maxVal;
+
+    static const int headerBits = 8 + 64 + 64;
+};
+
+// Reconstruction quality against the original samples. sqnrDb is the ideal figure for the
+// quantizer step, from its uniform granular noise; snrDb is what was measured.
+struct ReconstructionReport
+{
+    size_t samples;
+    double signalPower;
+    double noisePower;
+    double snrDb;
+    double sqnrDb;
+};
+
+class Modulator
+{
+public:
+    // Quantizes to `bits`-bit codes over the input's own range. Code c stands for the
+    // interval starting at minVal + c * step.
+    static void quantizePCM(const double *samples, size_t n, int bits, uint32_t *codes, double &minVal, double &step)
+    {
+        if (n == 0)
+            return;
+        pcmRange(samples, n, bits, minVal, step);
+        SampleKernels::quantize(samples, n, minVal, step, (uint32_t)(((uint64_t)1 << bits) - 1), codes);
+    }
+
+    // Codewords are 1 to 32 bits wide; other widths give an empty stream.
+    static BitStream encodePCM(const vector<double> &analogSignal, int bits = 8)
+    {
+        BitStream digitalData;
+        if (analogSignal.empty() || !validPCMBits(bits))
+            return digitalData;
+
+        double minVal, step;
+        pcmRange(analogSignal.data(), analogSignal.size(), bits, minVal, step);
+        digitalData.reserve(analogSignal.size() * bits);
+        appendPCM(analogSignal, bits, minVal, step, digitalData);
+        return digitalData;
+    }
+
+    // encodePCM preceded by a PcmHeader, so that decodePCM needs nothing else.
+    static BitStream encodePCMWithHeader(const vector<double> &analogSignal, int bits = 8)
+    {
+        BitStream digitalData;
+        if (!validPCMBits(bits))
+            return digitalData;
+        double minVal = 0, maxVal = 0;
+        if (!analogSignal.empty())
+            SampleKernels::minMax(analogSignal.data(), analogSignal.size(), minVal, maxVal);
+        double step = (maxVal - minVal) / (double)((uint64_t)1 << bits);
+
+        digitalData.reserve(PcmHeader::headerBits + analogSignal.size() * bits);
+        digitalData.appendCodeword((uint64_t)bits, 8);
+        digitalData.appendCodeword(doubleBits(minVal), 64);
+        digitalData.appendCodeword(doubleBits(maxVal), 64);
+        appendPCM(analogSignal, bits, minVal, step, digitalData);
+        return digitalData;
+    }
+
+    // False when the stream is too short for a header or the width is out of range.
+    static bool readPCMHeader(const BitStream &digitalData, PcmHeader &header)
+    {
+        if (digitalData.size() < (size_t)PcmHeader::headerBits)
+            return false;
+        header.bits = (int)(SampleKernels::reverse32((uint32_t)digitalData.getBits(0, 8)) >> 24);
+        header.minVal = bitsToDouble(readWord(digitalData, 8));
+        header.maxVal = bitsToDouble(readWord(digitalData, 72));
+        return validPCMBits(header.bits);
+    }
+
+    static vector<double> decodePCM(const BitStream &digitalData)
+    {
+        return decodePCM(digitalData, nullptr, nullptr);
+    }
+
+    // Decodes and, block by block while the samples are still in cache, compares them
+    // with the original input.
+    static vector<double> decodePCM(const BitStream &digitalData, const vector<double> &reference, ReconstructionReport &report)
+    {
+        return decodePCM(digitalData, &reference, &report);
+    }
+
+    // G.711 companded PCM of 16-bit linear samples, one code byte per sample.
+    static uint8_t linearToMuLaw(int16_t sample) { return SampleKernels::muLaw(sample); }
+    static uint8_t linearToALaw(int16_t sample) { return SampleKernels::aLaw(sample); }
+    static int16_t muLawToLinear(uint8_t code) { return SampleKernels::companding().muLaw[code]; }
+    static int16_t aLawToLinear(uint8_t code) { return SampleKernels::companding().aLaw[code]; }
+
+    static void encodeMuLaw(const int16_t *samples, size_t n, uint8_t *codes)
+    {
+        SampleKernels::encodeMuLaw(samples, n, codes);
+    }
+
+    static void encodeALaw(const int16_t *samples, size_t n, uint8_t *codes)
+    {
+        SampleKernels::encodeALaw(samples, n, codes);
+    }
+
+    static void decodeMuLaw(const uint8_t *codes, size_t n, int16_t *samples)
+    {
+        const int16_t *table = SampleKernels::companding().muLaw;
+        for (size_t i = 0; i < n; i++)
+        {
+            samples[i] = table[codes[i]];
+        }
+    }
+
+    static void decodeALaw(const uint8_t *codes, size_t n, int16_t *samples)
+    {
+        const int16_t *table = SampleKernels::companding().aLaw;
+        for (size_t i = 0; i < n; i++)
+        {
+            samples[i] = table[codes[i]];
+        }
+    }
+
+    // Analog samples with full scale +-1 as 8-bit G.711 codewords, MSB first like encodePCM.
+    static BitStream encodeMuLaw(const vector<double> &analogSignal)
+    {
+        return encodeCompanded(analogSignal, SampleKernels::encodeMuLaw);
+    }
+
+    static BitStream encodeALaw(const vector<double> &analogSignal)
+    {
+        return encodeCompanded(analogSignal, SampleKernels::encodeALaw);
+    }
+
+    static vector<double> decodeMuLaw(const BitStream &digitalData)
+    {
+        return decodeCompanded(digitalData, SampleKernels::companding().muLaw);
+    }
+
+    static vector<double> decodeALaw(const BitStream &digitalData)
+    {
+        return decodeCompanded(digitalData, SampleKernels::companding().aLaw);
+    }
+
+    // Continuously variable slope delta modulation; one bit per sample.
+    static BitStream encodeCVSD(const vector<double> &analogSignal, const CvsdFormat &format = CvsdFormat())
+    {
+        return CvsdEncoder(format).push(analogSignal);
+    }
+
+    static vector<double> decodeCVSD(const BitStream &digitalData, const CvsdFormat &format = CvsdFormat())
+    {
+        return CvsdDecoder(format).push(digitalData);
+    }
+
+    // Sigma-delta at the input rate; decoding returns one sample per format.decimation bits.
+    static BitStream encodeSigmaDelta(const vector<double> &analogSignal, const SigmaDeltaFormat &format = SigmaDeltaFormat())
+    {
+        return SigmaDeltaEncoder(format).push(analogSignal);
+    }
+
+    static vector<double> decodeSigmaDelta(const BitStream &digitalData, const SigmaDeltaFormat &format = SigmaDeltaFormat())
+    {
+        return SigmaDeltaDecoder(format).push(digitalData);
+    }
+
+    // DPCM against the previous reconstructed sample: each difference is rounded to a
+    // multiple of `step` and sent as a signed `bits`-bit codeword, MSB first.
+    static BitStream encodeDPCM(const vector<double> &analogSignal, int bits = 4, double step = 1.0 / 64)
+    {
+        checkDPCMBits(bits);
+        const size_t blockSamples = 1024;
+        int32_t codes[blockSamples];
+        int32_t lowest = -(1 << (bits - 1));
+        int32_t highest = (1 << (bits - 1)) - 1;
+        uint32_t codeMask = (uint32_t)(((uint64_t)1 << bits) - 1);
+        double prediction = 0;
+
+        BitStream digitalData;
+        digitalData.reserve(analogSignal.size() * bits);
+        for (size_t first = 0; first < analogSignal.size(); first += blockSamples)
+        {
+            size_t count = min(blockSamples, analogSignal.size() - first);
+            for (size_t i = 0; i < count; i++)
+            {
+                int32_t code = (int32_t)lround((analogSignal[first + i] - prediction) / step);
+                code = max(lowest, min(highest, code));
+                prediction += code * step;
+                codes[i] = (int32_t)((uint32_t)code & codeMask);
+            }
+            SampleKernels::packCodewords(codes, count, bits, digitalData);
+        }
+        return digitalData;
+    }
+
+    static vector<double> decodeDPCM(const BitStream &digitalData, int bits = 4, double step = 1.0 / 64)
+    {
+        checkDPCMBits(bits);
+        vector<double> analogSignal(digitalData.size() / bits);
+        double prediction = 0;
+        for (size_t i = 0; i < analogSignal.size(); i++)
+        {
+            // The codeword lands in the top bits, so an arithmetic shift sign-extends it.
+            int32_t code = (int32_t)SampleKernels::reverse32((uint32_t)digitalData.getBits(bits * i, bits)) >> (32 - bits);
+            prediction += code * step;
+            analogSignal[i] = prediction;
+        }
+        return analogSignal;
+    }
+
+    // IMA-ADPCM at 4 bits per sample of full scale +-1, channels interleaved frame by
+    // frame. All channels must have the same length.
+    static BitStream encodeADPCM(const vector<vector<double>> &channels)
+    {
+        const size_t blockFrames = 256;
+        size_t numChannels = channels.size();
+        size_t numFrames = channels.empty() ? 0 : channels[0].size();
+        vector<int16_t> linear(blockFrames * numChannels);
+        vector<uint8_t> codes(blockFrames * numChannels);
+        vector<AdpcmChannel> state(numChannels);
+
+        BitStream digitalData;
+        digitalData.reserve(4 * numFrames * numChannels);
+        for (size_t first = 0; first < numFrames; first += blockFrames)
+        {
+            size_t count = min(blockFrames, numFrames - first);
+            for (size_t f = 0; f < count; f++)
+            {
+                for (size_t c = 0; c < numChannels; c++)
+                {
+                    linear[f * numChannels + c] = (int16_t)max(-32768.0, min(32767.0, channels[c][first + f] * 32768.0));
+                }
+            }
+            ImaAdpcm::encode(linear.data(), count, state, codes.data());
+            SampleKernels::packCodewords(codes.data(), count * numChannels, 4, digitalData);
+        }
+        return digitalData;
+    }
+
+    static BitStream encodeADPCM(const vector<double> &analogSignal)
+    {
+        return encodeADPCM(vector<vector<double>>(1, analogSignal));
+    }
+
+    static vector<vector<double>> decodeADPCM(const BitStream &digitalData, size_t numChannels,
+                                              ThreadPool &pool = ThreadPool::shared())
+    {
+        if (numChannels == 0)
+            return vector<vector<double>>();
+        size_t numFrames = digitalData.size() / (4 * numChannels);
+        size_t numCodes = numFrames * numChannels;
+        vector<uint8_t> codes(numCodes);
+        for (size_t i = 0; i < numCodes; i += 8)
+        {
+            uint32_t nibbles = SampleKernels::reverse32((uint32_t)digitalData.getBits(4 * i, (int)min((size_t)32, 4 * (numCodes - i))));
+            for (size_t k = 0; k < 8 && i + k < numCodes; k++, nibbles <<= 4)
+            {
+                codes[i + k] = nibbles >> 28;
+            }
+        }
+
+        vector<int16_t> linear(numCodes);
+        vector<AdpcmChannel> state(numChannels);
+        ImaAdpcm::decode(codes.data(), numFrames, state, linear.data(), pool);
+
+        vector<vector<double>> channels(numChannels, vector<double>(numFrames));
+        for (size_t f = 0; f < numFrames; f++)
+        {
+            for (size_t c = 0; c < numChannels; c++)
+            {
+                channels[c][f] = linear[f * numChannels + c] / 32768.0;
+            }
+        }
+        return channels;
+    }
+
+    static vector<double> decodeADPCM(const BitStream &digitalData)
+    {
+        return move(decodeADPCM(digitalData, 1)[0]);
+    }
+
+    static BitStream encodeDM(const vector<double> &analogSignal, double delta = 0.5)
+    {
+        BitStream digitalData;
+        if (analogSignal.empty())
+            return digitalData;
+        double approximation = analogSignal[0];
+
+        for (size_t i = 1; i < analogSignal.size(); i++)
+        {
+            if (analogSignal[i] > approximation)
+            {
+                digitalData.pushBit(true);
+                approximation += delta;
+            }
+            else
+            {
+                digitalData.pushBit(false);
+                approximation -= delta;
+            }
+        }
+        return digitalData;
+    }
+
+    // Rebuilds the encodeDM staircase from its starting value, one sample more than there
+    // are bits. filterWindow > 1 smooths it with a centred moving average of that many
+    // samples, which removes most of the granular noise without delaying the signal.
+    static vector<double> decodeDM(const BitStream &digitalData, double delta = 0.5, double initial = 0, int filterWindow = 1)
+    {
+        return decodeDM(digitalData, delta, initial, filterWindow, nullptr, nullptr);
+    }
+
+    // As above, starting from reference[0] the way encodeDM does.
+    static vector<double> decodeDM(const BitStream &digitalData, const vector<double> &reference, ReconstructionReport &report,
+                                   double delta = 0.5, int filterWindow = 1)
+    {
+        return decodeDM(digitalData, delta, reference.empty() ? 0 : reference[0], filterWindow, &reference, &report);
+    }
+
+    static bool validPCMBits(int bits)
+    {
+        return bits >= 1 && bits <= 32;
+    }
+
+private:
+    // A signed DPCM codeword needs a sign bit and a magnitude bit, and its shifts stay in 32 bits.
+    static void checkDPCMBits(int bits)
+    {
+        if (bits < 2 || bits > 31)
+            throw invalid_argument("DPCM codeword width must be between 2 and 31 bits");
+    }
+
+    static void appendPCM(const vector<double> &analogSignal, int bits, double minVal, double step, BitStream &digitalData)
+    {
+        const size_t blockSamples = 1024;
+        uint32_t codes[blockSamples];
+        uint32_t maxCode = (uint32_t)(((uint64_t)1 << bits) - 1);
+        for (size_t first = 0; first < analogSignal.size(); first += blockSamples)
+        {
+            size_t count = min(blockSamples, analogSignal.size() - first);
+            SampleKernels::quantize(analogSignal.data() + first, count, minVal, step, maxCode, codes);
+            SampleKernels::packCodewords(codes, count, bits, digitalData);
+        }
+    }
+
+    static vector<double> decodePCM(const BitStream &digitalData, const vector<double> *reference, ReconstructionReport *report)
+    {
+        PcmHeader header;
+        if (!readPCMHeader(digitalData, header))
+            return vector<double>();
+        double step = (header.maxVal - header.minVal) / (double)((uint64_t)1 << header.bits);
+        size_t numSamples = (digitalData.size() - PcmHeader::headerBits) / header.bits;
+        vector<double> analogSignal(numSamples);
+
+        const size_t blockSamples = 1024;
+        uint32_t codes[blockSamples];
+        double signalSum = 0, errorSum = 0;
+        size_t compared = reference ? min(reference->size(), numSamples) : 0;
+        for (size_t first = 0; first < numSamples; first += blockSamples)
+        {
+            size_t count = min(blockSamples, numSamples - first);
+            SampleKernels::unpackCodewords(digitalData, PcmHeader::headerBits + first * header.bits, count, header.bits, codes);
+            SampleKernels::reconstruct(codes, count, header.minVal, step, analogSignal.data() + first);
+            if (first < compared)
+                SampleKernels::accumulateError(reference->data() + first, analogSignal.data() + first,
+                                               min(count, compared - first), signalSum, errorSum);
+        }
+        if (report)
+            fillReport(*report, compared, signalSum, errorSum, step * step / 12);
+        return analogSignal;
+    }
+
+    static vector<double> decodeDM(const BitStream &digitalData, double delta, double initial, int filterWindow,
+                                   const vector<double> *reference, ReconstructionReport *report)
+    {
+        size_t numBits = digitalData.size();
+        vector<double> analogSignal(numBits + 1);
+        analogSignal[0] = initial;
+
+        double signalSum = 0, errorSum = 0;
+        size_t compared = reference ? min(reference->size(), analogSignal.size()) : 0;
+        if (filterWindow > 1)
+        {
+            SampleKernels::integrateDelta(digitalData.data(), numBits, initial, delta, analogSignal.data() + 1);
+            smooth(analogSignal, filterWindow, reference ? reference->data() : nullptr, compared, signalSum, errorSum);
+        }
+        else
+        {
+            // Compare each block against the reference while it is still in cache.
+            const size_t blockBits = 4096;
+            double level = initial;
+            size_t done = 0;
+            for (size_t first = 0; first < numBits || done < compared; first += blockBits)
+            {
+                size_t count = first < numBits ? min(blockBits, numBits - first) : 0;
+                level = SampleKernels::integrateDelta(digitalData.data() + first / 64, count, level, delta,
+                                                      analogSignal.data() + 1 + first);
+                size_t end = min(compared, first + count + 1);
+                if (end > done)
+                    SampleKernels::accumulateError(reference->data() + done, analogSignal.data() + done, end - done,
+                                                   signalSum, errorSum);
+                done = max(done, end);
+            }
+        }
+        // Granular noise of a staircase moving +-delta is uniform over +-delta.
+        if (report)
+            fillReport(*report, compared, signalSum, errorSum, delta * delta / 3);
+        return analogSignal;
+    }
+
+    static void fillReport(ReconstructionReport &report, size_t samples, double signalSum, double errorSum, double quantizationNoise)
+    {
+        report.samples = samples;
+        report.signalPower = samples ? signalSum / samples : 0;
+        report.noisePower = samples ? errorSum / samples : 0;
+        report.snrDb = 0;
+        report.sqnrDb = 0;
+        // Nothing was compared, so there is no SNR to give.
+        if (samples == 0)
+            return;
+        report.snrDb = 10 * log10(report.signalPower / report.noisePower);
+        report.sqnrDb = 10 * log10(report.signalPower / quantizationNoise);
+    }
+
+    // Centred moving average; the window shrinks at the ends to the samples that exist. The
+    // first `compared` outputs are checked against `reference` as they are written.
+    static void smooth(vector<double> &samples, int window, const double *reference, size_t compared,
+                       double &signalSum, double &errorSum)
+    {
+        size_t n = samples.size();
+        vector<double> prefix(n + 1, 0.0);
+        for (size_t i = 0; i < n; i++)
+        {
+            prefix[i + 1] = prefix[i] + samples[i];
+        }
+        size_t before = (size_t)window / 2, after = (size_t)window - 1 - before;
+        for (size_t i = 0; i < n; i++)
+        {
+            size_t lo = i >= before ? i - before : 0;
+            size_t hi = min(n, i + after + 1);
+            samples[i] = (prefix[hi] - prefix[lo]) / (double)(hi - lo);
+            if (i < compared)
+            {
+                double error = reference[i] - samples[i];
+                signalSum += reference[i] * reference[i];
+                errorSum += error * error;
+            }
+        }
+    }
+
+    static uint64_t doubleBits(double value)
+    {
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof bits);
+        return bits;
+    }
+
+    static double bitsToDouble(uint64_t bits)
+    {
+        double value;
+        memcpy(&value, &bits, sizeof value);
+        return value;
+    }
+
+    // A 64-bit MSB-first codeword at `pos`.
+    static uint64_t readWord(const BitStream &digitalData, size_t pos)
+    {
+        uint64_t raw = digitalData.getBits(pos, 64);
+        return ((uint64_t)SampleKernels::reverse32((uint32_t)raw) << 32) | SampleKernels::reverse32((uint32_t)(raw >> 32));
+    }
+
+    static BitStream encodeCompanded(const vector<double> &analogSignal, void (*compress)(const int16_t *, size_t, uint8_t *))
+    {
+        const size_t blockSamples = 1024;
+        int16_t linear[blockSamples];
+        uint8_t codes[blockSamples];
+        BitStream digitalData;
+        digitalData.reserve(8 * analogSignal.size());
+        for (size_t first = 0; first < analogSignal.size(); first += blockSamples)
+        {
+            size_t count = min(blockSamples, analogSignal.size() - first);
+            for (size_t i = 0; i < count; i++)
+            {
+                linear[i] = (int16_t)max(-32768.0, min(32767.0, analogSignal[first + i] * 32768.0));
+            }
+            compress(linear, count, codes);
+            SampleKernels::packCodewords(codes, count, 8, digitalData);
+        }
+        return digitalData;
+    }
+
+    static vector<double> decodeCompanded(const BitStream &digitalData, const int16_t *table)
+    {
+        vector<double> analogSignal(digitalData.size() / 8);
+        for (size_t i = 0; i < analogSignal.size(); i++)
+        {
+            uint8_t code = SampleKernels::reverse32((uint32_t)digitalData.getBits(8 * i, 8)) >> 24;
+            analogSignal[i] = table[code] / 32768.0;
+        }
+        return analogSignal;
+    }
+
+    static void pcmRange(const double *samples, size_t n, int bits, double &minVal, double &step)
+    {
+        double maxVal;
+        SampleKernels::minMax(samples, n, minVal, maxVal);
+        step = (maxVal - minVal) / (double)((uint64_t)1 << bits);
+    }
+};
+
+// ==================== PASSBAND MODULATION ====================
+
+enum class PassbandScheme
+{
+    ASK,
+    FSK,
+    BPSK,
+    QPSK,
+    QAM16
+};
+
+// Frequencies are in cycles per sample. Correlation over a symbol is exact when
+// carrier * samplesPerSymbol is a multiple of one half, and FSK tones, at carrier +-
+// toneSpacing / 2, are orthogonal when toneSpacing is a multiple of 1 / samplesPerSymbol.
+struct PassbandFormat
+{
+    PassbandScheme scheme = PassbandScheme::QPSK;
+    int samplesPerSymbol = 16;
+    double carrier = 0.25;
+    double toneSpacing = 0.0625;
+
+    static const PassbandFormat &checked(const PassbandFormat &format)
+    {
+        if (format.samplesPerSymbol < 1)
+            throw invalid_argument("Passband symbols need at least one sample");
+        return format;
+    }
+};
+
+// Numerically controlled oscillator: a PhaseAccumulator read through a 1024-entry sine
+// table, interpolating linearly on the 22 phase bits below the table index.
+class Nco
+{
+public:
+    explicit Nco(double frequency, double phase = 0) : accumulator(frequency, phase) {}
+
+    // cos and sin of the current phase; the phase then advances by one sample.
+    void next(float &cosine, float &sine)
+    {
+        uint32_t phase = (uint32_t)(accumulator.phase >> 32);
+        cosine = lookup(phase + 0x40000000u);
+        sine = lookup(phase);
+        accumulator.phase += accumulator.increment;
+    }
+
+    static float lookup(uint32_t phase)
+    {
+        const float *table = sineTable().values;
+        uint32_t index = phase >> 22;
+        float fraction = (phase & 0x3FFFFF) * (1.0f / 4194304.0f);
+        return table[index] + fraction * (table[index + 1] - table[index]);
+    }
+
+private:
+    PhaseAccumulator accumulator;
+
+    struct SineTable
+    {
+        float values[1025];
+
+        SineTable()
+        {
+            for (int i = 0; i <= 1024; i++)
+            {
+                values[i] = (float)sin(2 * M_PI * i / 1024);
+            }
+        }
+    };
+
+    static const SineTable &sineTable()
+    {
+        static const SineTable table;
+        return table;
+    }
+};
+
+// Bits map to symbols LSB first, bitsPerSymbol() at a time, and the data is padded with
+// zeros to a whole symbol. Amplitude schemes send I cos - Q sin with one constellation
+// point per symbol; QPSK and 16-QAM are Gray coded on each axis. The demodulators
+// regenerate the carrier from the same NCO and correlate over each symbol.
+class PassbandModulator
+{
+public:
+    static int bitsPerSymbol(PassbandScheme scheme)
+    {
+        switch (scheme)
+        {
+        case PassbandScheme::QPSK:
+            return 2;
+        case PassbandScheme::QAM16:
+            return 4;
+        default:
+            return 1;
+        }
+    }
+
+    static vector<float> modulate(const BitStream &data, const PassbandFormat &format = PassbandFormat())
+    {
+        int k = bitsPerSymbol(format.scheme);
+        size_t numSymbols = (data.size() + k - 1) / k;
+        BitStream padded = data;
+        padded.resize(numSymbols * k);
+
+        // Symbol mapping in one pass ahead of the carrier loop.
+        float pointI[16], pointQ[16];
+        constellation(format.scheme, pointI, pointQ);
+        vector<uint8_t> codes(numSymbols);
+        for (size_t s = 0; s < numSymbols; s++)
+        {
+            codes[s] = (uint8_t)padded.getBits(s * k, k);
+        }
+
+        size_t n = (size_t)PassbandFormat::checked(format).samplesPerSymbol;
+        vector<float> waveform(numSymbols * n);
+        float cosine, sine;
+        if (format.scheme == PassbandScheme::FSK)
+        {
+            Nco space(format.carrier - format.toneSpacing / 2);
+            Nco mark(format.carrier + format.toneSpacing / 2);
+            float spaceCos, spaceSin;
+            for (size_t s = 0; s < numSymbols; s++)
+            {
+                float *out = waveform.data() + s * n;
+                for (size_t i = 0; i < n; i++)
+                {
+                    // Both tones keep running so that each stays coherent with the receiver's copy.
+                    space.next(spaceCos, spaceSin);
+                    mark.next(cosine, sine);
+                    out[i] = codes[s] ? cosine : spaceCos;
+                }
+            }
+            return waveform;
+        }
+
+        Nco carrier(format.carrier);
+        for (size_t s = 0; s < numSymbols; s++)
+        {
+            float i0 = pointI[codes[s]], q0 = pointQ[codes[s]];
+            float *out = waveform.data() + s * n;
+            for (size_t i = 0; i < n; i++)
+            {
+                carrier.next(cosine, sine);
+                out[i] = i0 * cosine - q0 * sine;
+            }
+        }
+        return waveform;
+    }
+
+    static BitStream demodulate(const vector<float> &waveform, const PassbandFormat &format = PassbandFormat())
+    {
+        int k = bitsPerSymbol(format.scheme);
+        size_t n = (size_t)PassbandFormat::checked(format).samplesPerSymbol;
+        size_t numSymbols = waveform.size() / n;
+        BitStream data;
+        data.reserve(numSymbols * k);
+
+        float cosine, sine;
+        if (format.scheme == PassbandScheme::FSK)
+        {
+            Nco space(format.carrier - format.toneSpacing / 2);
+            Nco mark(format.carrier + format.toneSpacing / 2);
+            float spaceCos, spaceSin;
+            for (size_t s = 0; s < numSymbols; s++)
+            {
+                const float *in = waveform.data() + s * n;
+                float spaceSum = 0, markSum = 0;
+                for (size_t i = 0; i < n; i++)
+                {
+                    space.next(spaceCos, spaceSin);
+                    mark.next(cosine, sine);
+                    spaceSum += in[i] * spaceCos;
+                    markSum += in[i] * cosine;
+                }
+                data.pushBit(markSum > spaceSum);
+            }
+            return data;
+        }
+
+        Nco carrier(format.carrier);
+        float scale = 2.0f / n;
+        for (size_t s = 0; s < numSymbols; s++)
+        {
+            const float *in = waveform.data() + s * n;
+            float sumI = 0, sumQ = 0;
+            for (size_t i = 0; i < n; i++)
+            {
+                carrier.next(cosine, sine);
+                sumI += in[i] * cosine;
+                sumQ -= in[i] * sine;
+            }
+            data.appendBits(slice(format.scheme, sumI * scale, sumQ * scale), k);
+        }
+        return data;
+    }
+
+private:
+    // Two bits per axis, Gray coded: 00 -3, 01 -1, 11 +1, 10 +3.
+    static float qamLevel(unsigned bits)
+    {
+        unsigned index = bits ^ (bits >> 1);
+        return (2.0f * index - 3.0f) / sqrt(10.0f);
+    }
+
+    static void constellation(PassbandScheme scheme, float *pointI, float *pointQ)
+    {
+        const float half = (float)M_SQRT1_2;
+        for (unsigned code = 0; code < 16; code++)
+        {
+            switch (scheme)
+            {
+            case PassbandScheme::ASK:
+                pointI[code] = (float)(code & 1);
+                pointQ[code] = 0;
+                break;
+            case PassbandScheme::QPSK:
+                pointI[code] = (code & 1) ? half : -half;
+                pointQ[code] = (code & 2) ? half : -half;
+                break;
+            case PassbandScheme::QAM16:
+                pointI[code] = qamLevel(code & 3);
+                pointQ[code] = qamLevel((code >> 2) & 3);
+                break;
+            default:
+                pointI[code] = (code & 1) ? 1.0f : -1.0f;
+                pointQ[code] = 0;
+            }
+        }
+    }
+
+    static uint64_t slice(PassbandScheme scheme, float i, float q)
+    {
+        switch (scheme)
+        {
+        case PassbandScheme::ASK:
+            return i > 0.5f;
+        case PassbandScheme::QPSK:
+            return (i > 0) | ((q > 0) << 1);
+        case PassbandScheme::QAM16:
+            return sliceQam(i) | (sliceQam(q) << 2);
+        default:
+            return i > 0;
+        }
+    }
+
+    static uint64_t sliceQam(float level)
+    {
+        float threshold = 2.0f / sqrt(10.0f);
+        unsigned index = level < -threshold ? 0 : level < 0 ? 1 : level < threshold ? 2 : 3;
+        return index ^ (index >> 1);
+    }
+};
+
+// ==================== STREAMING PCM ====================
+
+// How a streaming PCM coder sets its quantization range. Fixed uses a configured
+// full scale for the whole stream; BlockFloatingPoint picks a power-of-two scale per
+// block from the block's peak and sends its exponent in-band ahead of the block.
+enum class PcmRange
+{
+    Fixed,
+    BlockFloatingPoint
+};
+
+struct PcmFormat
+{
+    PcmRange range;
+    int bits;            // codeword width, 1 to 31
+    double fullScale;    // Fixed: codes span [-fullScale, fullScale) and samples outside clip
+    size_t blockSamples; // samples per block; BlockFloatingPoint sends one scale per block
+
+    static const int scaleBits = 8; // block exponent, two's complement, MSB first
+
+    // The quantizer for a block with the given exponent (ignored for Fixed ranges).
+    void quantizer(int exponent, double &minVal, double &step) const
+    {
+        double scale = (range == PcmRange::Fixed) ? fullScale : ldexp(1.0, exponent);
+        minVal = -scale;
+        step = 2 * scale / (double)((uint64_t)1 << bits);
+    }
+
+    // The streaming coders take only formats they can run: wider codewords overflow the
+    // 32-bit code shifts and an empty block never fills.
+    static const PcmFormat &checked(const PcmFormat &format)
+    {
+        if (format.bits < 1 || format.bits > 31)
+            throw invalid_argument("PCM codeword width must be between 1 and 31 bits");
+        if (format.blockSamples == 0)
+            throw invalid_argument("PCM blocks must hold at least one sample");
+        return format;
+    }
+};
+
+// Encodes samples as they arrive. Memory stays at one block whatever the stream length:
+// BlockFloatingPoint holds samples back until their block is complete, and flush()
+// sends the last, shorter block.
+class StreamingPcmEncoder
+{
+public:
+    explicit StreamingPcmEncoder(const PcmFormat &pcmFormat)
+        : format(PcmFormat::checked(pcmFormat)), pending(format.blockSamples), numPending(0), codes(format.blockSamples) {}
+
+    BitStream push(const double *samples, size_t n)
+    {
+        BitStream out;
+        out.reserve(n * format.bits + (n / format.blockSamples + 1) * PcmFormat::scaleBits);
+        while (n > 0)
+        {
+            size_t count = min(n, format.blockSamples - numPending);
+            copy(samples, samples + count, pending.begin() + numPending);
+            numPending += count;
+            samples += count;
+            n -= count;
+            if (numPending == format.blockSamples || format.range == PcmRange::Fixed)
+                encodeBlock(out);
+        }
+        return out;
+    }
+
+    BitStream push(const vector<double> &samples)
+    {
+        return push(samples.data(), samples.size());
+    }
+
+    BitStream flush()
+    {
+        BitStream out;
+        if (numPending > 0)
+            encodeBlock(out);
+        return out;
+    }
+
+private:
+    PcmFormat format;
+    vector<double> pending;
+    size_t numPending;
+    vector<uint32_t> codes;
+
+    void encodeBlock(BitStream &out)
+    {
+        int exponent = 0;
+        if (format.range == PcmRange::BlockFloatingPoint)
+        {
+            double lo, hi;
+            SampleKernels::minMax(pending.data(), numPending, lo, hi);
+            // frexp gives peak = m * 2^exponent with m < 1, so the block fits in +-2^exponent.
+            frexp(max(-lo, hi), &exponent);
+            exponent = max(-128, min(127, exponent));
+            out.appendCodeword((uint8_t)exponent, PcmFormat::scaleBits);
+        }
+        double minVal, step;
+        format.quantizer(exponent, minVal, step);
+        SampleKernels::quantize(pending.data(), numPending, minVal, step, (uint32_t)(((uint64_t)1 << format.bits) - 1), codes.data());
+        SampleKernels::packCodewords(codes.data(), numPending, format.bits, out);
+        numPending = 0;
+    }
+};
+
+// Decodes the stream of a StreamingPcmEncoder with the same format, in chunks of any size.
+// Each code is reconstructed at the middle of its interval. Only bits short of the next
+// codeword or block header are carried between calls.
+class StreamingPcmDecoder
+{
+public:
+    explicit StreamingPcmDecoder(const PcmFormat &pcmFormat)
+        : format(PcmFormat::checked(pcmFormat)), blockLeft(0), exponent(0) {}
+
+    vector<double> push(const BitStream &chunk)
+    {
+        carry.append(chunk);
+        vector<double> samples;
+        samples.reserve(carry.size() / format.bits);
+
+        double minVal, step;
+        format.quantizer(exponent, minVal, step);
+        size_t pos = 0;
+        while (true)
+        {
+            if (format.range == PcmRange::BlockFloatingPoint && blockLeft == 0)
+            {
+                if (pos + PcmFormat::scaleBits > carry.size())
+                    break;
+                exponent = (int8_t)readCodeword(pos, PcmFormat::scaleBits);
+                format.quantizer(exponent, minVal, step);
+                blockLeft = format.blockSamples;
+                pos += PcmFormat::scaleBits;
+            }
+            if (pos + format.bits > carry.size())
+                break;
+            samples.push_back(minVal + (readCodeword(pos, format.bits) + 0.5) * step);
+            pos += format.bits;
+            blockLeft -= (format.range == PcmRange::BlockFloatingPoint);
+        }
+
+        BitStream rest;
+        for (; pos < carry.size(); pos += 64)
+        {
+            int count = (int)min((size_t)64, carry.size() - pos);
+            rest.appendBits(carry.getBits(pos, count), count);
+        }
+        carry = rest;
+        return samples;
+    }
+
+    // Drops any partial codeword and readies the decoder for the next stream.
+    void flush()
+    {
+        carry.clear();
+        blockLeft = 0;
+        exponent = 0;
+    }
+
+private:
+    PcmFormat format;
+    BitStream carry;
+    size_t blockLeft;
+    int exponent;
+
+    uint32_t readCodeword(size_t pos, int bits) const
+    {
+        return SampleKernels::reverse32((uint32_t)carry.getBits(pos, bits)) >> (32 - bits);
+    }
+};
+
+// ==================== DECODER ====================
+
+class LineDecoder
+{
+public:
+    // Bits recovered from numSamples samples; an unpaired trailing Manchester sample is dropped.
+    static size_t decodedLength(LineCodeScheme scheme, size_t numSamples)
+    {
+        if (scheme == LineCodeScheme::Manchester || scheme == LineCodeScheme::DifferentialManchester)
+            return numSamples / 2;
+        return numSamples;
+    }
+
+    // Writes decodedLength() '0'/'1' characters to out and returns that count.
+    static size_t decodeInto(const int8_t *signal, size_t numSamples, LineCodeScheme scheme, char *out)
+    {
+        size_t numBits = decodedLength(scheme, numSamples);
+        switch (scheme)
+        {
+        case LineCodeScheme::NRZL:
+            NrzlCode::decode(signal, numBits, out);
+            break;
+        case LineCodeScheme::NRZI:
+            NrziCode::decode(signal, numBits, out);
+            break;
+        case LineCodeScheme::Manchester:
+            ManchesterCode::decode(signal, numBits, out);
+            break;
+        case LineCodeScheme::DifferentialManchester:
+            DifferentialManchesterCode::decode(signal, numBits, out);
+            break;
+        case LineCodeScheme::AMI:
+            AmiCode::decode(signal, numBits, out);
+            break;
+        case LineCodeScheme::MLT3:
+            Mlt3Code::decode(signal, numBits, out);
+            break;
+        }
+        return numBits;
+    }
+
+    // Packed counterpart of decodeInto: fills (decodedLength() + 63) / 64 words of bits,
+    // LSB first, and returns the bit count.
+    static size_t decodePackedInto(const int8_t *signal, size_t numSamples, LineCodeScheme scheme, uint64_t *bits)
+    {
+        size_t numBits = decodedLength(scheme, numSamples);
+        switch (scheme)
+        {
+        case LineCodeScheme::NRZL:
+            decodePackedWith<NrzlCode>(signal, numBits, bits);
+            break;
+        case LineCodeScheme::NRZI:
+            decodePackedWith<NrziCode>(signal, numBits, bits);
+            break;
+        case LineCodeScheme::Manchester:
+            decodePackedWith<ManchesterCode>(signal, numBits, bits);
+            break;
+        case LineCodeScheme::DifferentialManchester:
+            decodePackedWith<DifferentialManchesterCode>(signal, numBits, bits);
+            break;
+        case LineCodeScheme::AMI:
+            decodePackedWith<AmiCode>(signal, numBits, bits);
+            break;
+        case LineCodeScheme::MLT3:
+            decodePackedWith<Mlt3Code>(signal, numBits, bits);
+            break;
+        }
+        return numBits;
+    }
+
+    static BitStream decodePacked(const Signal &signal, LineCodeScheme scheme)
+    {
+        BitStream data;
+        data.resize(decodedLength(scheme, signal.size()));
+        decodePackedInto(signal.data(), signal.size(), scheme, data.data());
+        return data;
+    }
+
+    // Reuses out's capacity, so a buffer kept across calls stops allocating once it is large enough.
+    static void decodeInto(const Signal &signal, LineCodeScheme scheme, string &out)
+    {
+        out.resize(decodedLength(scheme, signal.size()));
+        decodeInto(signal.data(), signal.size(), scheme, &out[0]);
+    }
+
+    static string decodeNRZL(const Signal &signal)
+    {
+        string data;
+        decodeInto(signal, LineCodeScheme::NRZL, data);
+        return data;
+    }
+
+    static string decodeNRZI(const Signal &signal)
+    {
+        string data;
+        decodeInto(signal, LineCodeScheme::NRZI, data);
+        return data;
+    }
+
+    static string decodeManchester(const Signal &signal)
+    {
+        string data;
+        decodeInto(signal, LineCodeScheme::Manchester, data);
+        return data;
+    }
+
+    static string decodeDifferentialManchester(const Signal &signal)
+    {
+        string data;
+        decodeInto(signal, LineCodeScheme::DifferentialManchester, data);
+        return data;
+    }
+
+    static string decodeAMI(const Signal &signal)
+    {
+        string data;
+        decodeInto(signal, LineCodeScheme::AMI, data);
+        return data;
+    }
+
+    static string decodeMLT3(const Signal &signal)
+    {
+        string data;
+        decodeInto(signal, LineCodeScheme::MLT3, data);
+        return data;
+    }
+
+    // Inverse of LineEncoder::scramble. history holds the last 64 scrambled bits seen;
+    // from a wrong start it corrects itself after the longest tap.
+    template <class Scrambler>
+    static BitStream descramble(const BitStream &bits, uint64_t &history)
+    {
+        BitStream data;
+        data.resize(bits.size());
+        Scrambler::descramble(bits.data(), bits.size(), data.data(), history);
+        return data;
+    }
+
+    template <class Scrambler>
+    static BitStream descramble(const BitStream &bits)
+    {
+        uint64_t history = 0;
+        return descramble<Scrambler>(bits, history);
+    }
+
+    // Block-coded data back from a signal sent over NRZ-L, NRZ-I or MLT-3. Code groups
+    // that are not valid data come out as zeros and are counted in invalidGroups.
+    template <class Block>
+    static BitStream decodeBlockCoded(const Signal &signal, LineCodeScheme line, size_t &invalidGroups)
+    {
+        BitStream code;
+        code.resize(signal.size());
+        if (line == LineCodeScheme::NRZL)
+        {
+            vector<uint64_t> zero(code.wordCount());
+            LevelKernels::packLevels(signal.data(), signal.size(), code.data(), zero.data());
+        }
+        else
+        {
+            int8_t prevLevel = (line == LineCodeScheme::MLT3) ? 0 : -1;
+            LevelKernels::packNRZITransitions(signal.data(), signal.size(), code.data(), prevLevel);
+        }
+        return Block::decode(code, invalidGroups);
+    }
+
+    static string decode4B5B(const Signal &signal, LineCodeScheme line = LineCodeScheme::NRZI)
+    {
+        size_t invalidGroups;
+        return decodeBlockCoded<Block4B5B>(signal, line, invalidGroups).toString();
+    }
+
+    static string decode8B10B(const Signal &signal)
+    {
+        size_t invalidGroups;
+        return decodeBlockCoded<Block8B10B>(signal, LineCodeScheme::NRZL, invalidGroups).toString();
+    }
+
+    static string decode64B66B(const Signal &signal)
+    {
+        size_t invalidGroups;
+        return decodeBlockCoded<Block64B66B>(signal, LineCodeScheme::NRZL, invalidGroups).toString();
+    }
+
+    // AMI with B8ZS or HDB3, decoded straight from the line signal: substituted pulses
+    // come out as zeros.
+    static void decodeB8ZSInto(const int8_t *signal, size_t numSamples, char *out)
+    {
+        vector<uint64_t> bits((numSamples + 63) / 64);
+        LevelKernels::packB8ZS(signal, numSamples, bits.data());
+        LevelKernels::expandChars(bits.data(), numSamples, out);
+    }
+
+    static void decodeHDB3Into(const int8_t *signal, size_t numSamples, char *out)
+    {
+        vector<uint64_t> bits((numSamples + 63) / 64);
+        int8_t lastPulse = 1;
+        LevelKernels::packHDB3(signal, numSamples, bits.data(), lastPulse);
+        LevelKernels::expandChars(bits.data(), numSamples, out);
     }
 
-    int start = (centerIndex - maxLen) / 2;
-    return s.substr(start, maxLen);
-}
+    static string decodeB8ZS(const Signal &signal)
+    {
+        string data(signal.size(), '0');
+        decodeB8ZSInto(signal.data(), signal.size(), &data[0]);
+        return data;
+    }
 
-// ==================== LINE ENCODING SCHEMES ====================
+    static string decodeHDB3(const Signal &signal)
+    {
+        string data(signal.size(), '0');
+        decodeHDB3Into(signal.data(), signal.size(), &data[0]);
+        return data;
+    }
 
-class LineEncoder
-{
-public:
-    static vector<int> encodeNRZL(const string &data)
+    // The AMI signal the substitutions were made on.
+    static Signal descrambleB8ZS(Signal signal)
     {
-        vector<int> signal;
-        for (char bit : data)
-        {
-            signal.push_back(bit == '1' ? 1 : -1);
-        }
+        vector<uint64_t> bits((signal.size() + 63) / 64);
+        LevelKernels::packB8ZS(signal.data(), signal.size(), bits.data());
+        LevelKernels::expandAMI(bits.data(), signal.size(), signal.data());
         return signal;
     }
 
-    static vector<int> encodeNRZI(const string &data)
+    static Signal descrambleHDB3(Signal signal)
     {
-        vector<int> signal;
-        int currentLevel = -1;
-        for (char bit : data)
-        {
-            if (bit == '1')
-            {
-                currentLevel = -currentLevel;
-            }
-            signal.push_back(currentLevel);
-        }
+        vector<uint64_t> bits((signal.size() + 63) / 64);
+        int8_t lastPulse = 1;
+        LevelKernels::packHDB3(signal.data(), signal.size(), bits.data(), lastPulse);
+        LevelKernels::expandAMI(bits.data(), signal.size(), signal.data());
         return signal;
     }
 
-    static vector<int> encodeManchester(const string &data)
+private:
+    template <class Code>
+    static void decodePackedWith(const int8_t *signal, size_t numBits, uint64_t *bits)
     {
-        vector<int> signal;
-        for (char bit : data)
-        {
-            if (bit == '1')
-            {
-                signal.push_back(-1);
-                signal.push_back(1);
-            }
-            else
-            {
-                signal.push_back(1);
-                signal.push_back(-1);
-            }
-        }
-        return signal;
+        int8_t level = Code::startLevel;
+        Code::decodePacked(signal, numBits, bits, level);
     }
+};
+
+// ==================== STREAMING DECODERS ====================
 
-    static vector<int> encodeDifferentialManchester(const string &data)
+// Decodes a capture that arrives in chunks of any size, appending packed bits to a
+// caller's BitStream. The level a stateful code compares against (prevLevel for NRZ-I and
+// MLT-3, prevEndLevel for Differential Manchester) carries over from one push() to the
+// next, and a Manchester sample whose pair is still to come is held back. Concatenated,
+// the output equals LineDecoder::decodePacked over the whole capture.
+template <class Code>
+class StreamingDecoder
+{
+public:
+    StreamingDecoder() : level(Code::startLevel), heldSample(0), holding(false) {}
+
+    void push(const int8_t *signal, size_t numSamples, BitStream &out)
     {
-        vector<int> signal;
-        int currentLevel = 1;
+        uint64_t bits[blockBits / 64];
+        if (holding && numSamples > 0)
+        {
+            int8_t pair[2] = {heldSample, signal[0]};
+            Code::decodePacked(pair, 1, bits, level);
+            out.appendBits(bits[0], 1);
+            signal++;
+            numSamples--;
+            holding = false;
+        }
 
-        for (char bit : data)
+        size_t numBits = numSamples / Code::samplesPerBit;
+        for (size_t first = 0; first < numBits; first += blockBits)
         {
-            if (bit == '0')
+            size_t count = min(blockBits, numBits - first);
+            Code::decodePacked(signal + Code::samplesPerBit * first, count, bits, level);
+            for (size_t w = 0; w * 64 < count; w++)
             {
-                currentLevel = -currentLevel;
+                out.appendBits(bits[w], (int)min((size_t)64, count - w * 64));
             }
+        }
 
-            signal.push_back(currentLevel);
-            signal.push_back(-currentLevel);
-
-            currentLevel = -currentLevel;
+        if (numSamples % Code::samplesPerBit)
+        {
+            heldSample = signal[numSamples - 1];
+            holding = true;
         }
-        return signal;
     }
 
-    static vector<int> encodeAMI(const string &data)
+    BitStream push(const Signal &chunk)
     {
-        vector<int> signal;
-        int lastPulse = 1;
-        for (char bit : data)
-        {
-            if (bit == '0')
-            {
-                signal.push_back(0);
-            }
-            else
-            {
-                lastPulse = -lastPulse;
-                signal.push_back(lastPulse);
-            }
-        }
-        return signal;
+        BitStream out;
+        out.reserve(chunk.size() / Code::samplesPerBit + 1);
+        push(chunk.data(), chunk.size(), out);
+        return out;
     }
 
-    static vector<int> scrambleB8ZS(vector<int> signal)
+    // Drops any held sample and resets the level for the next capture.
+    void flush()
     {
-        int n = signal.size();
-        int lastPulse = 0;
+        level = Code::startLevel;
+        holding = false;
+    }
 
-        for (int i = 0; i <= n - 8; i++)
-        {
-            bool eightZeros = true;
-            for (int j = i; j < i + 8; j++)
-            {
-                if (signal[j] != 0)
-                {
-                    eightZeros = false;
-                    break;
-                }
-            }
+private:
+    static const size_t blockBits = 4096;
+    int8_t level;
+    int8_t heldSample;
+    bool holding;
+};
 
-            if (eightZeros)
-            {
-                for (int j = i - 1; j >= 0; j--)
-                {
-                    if (signal[j] != 0)
-                    {
-                        lastPulse = signal[j];
-                        break;
-                    }
-                }
-                if (lastPulse == 0)
-                    lastPulse = 1;
+template <class Code>
+const size_t StreamingDecoder<Code>::blockBits;
 
-                signal[i] = 0;
-                signal[i + 1] = 0;
-                signal[i + 2] = 0;
-                signal[i + 3] = lastPulse;
-                signal[i + 4] = -lastPulse;
-                signal[i + 5] = 0;
-                signal[i + 6] = -lastPulse;
-                signal[i + 7] = lastPulse;
+typedef StreamingDecoder<NrzlCode> NrzlDecoder;
+typedef StreamingDecoder<NrziCode> NrziDecoder;
+typedef StreamingDecoder<ManchesterCode> ManchesterDecoder;
+typedef StreamingDecoder<DifferentialManchesterCode> DifferentialManchesterDecoder;
+typedef StreamingDecoder<AmiCode> AmiDecoder;
+typedef StreamingDecoder<Mlt3Code> Mlt3Decoder;
 
-                i += 7;
-            }
-            else if (signal[i] != 0)
-            {
-                lastPulse = signal[i];
-            }
-        }
-        return signal;
+// ==================== LINE CODE PIPELINES ====================
+
+// Scrambling policies decide how a pipeline produces and reads its line signal.
+// NoScrambling runs the code's own kernels; B8ZS and HDB3 are only defined on AMI and
+// run the fused encoders and the substitution-aware decoders.
+struct NoScrambling
+{
+    static const char *suffix() { return ""; }
+
+    template <class Code>
+    static void encode(const BitStream &data, int8_t *out)
+    {
+        uint64_t parity = 0;
+        Code::encode(data.data(), data.size(), out, parity);
     }
 
-    static vector<int> scrambleHDB3(vector<int> signal)
+    template <class Code>
+    static void decode(const int8_t *signal, size_t numBits, char *out)
     {
-        int n = signal.size();
-        int lastPulse = 1;
-        int pulseCount = 0;
+        Code::decode(signal, numBits, out);
+    }
+};
 
-        for (int i = 0; i <= n - 4; i++)
-        {
-            bool fourZeros = true;
-            for (int j = i; j < i + 4; j++)
-            {
-                if (signal[j] != 0)
-                {
-                    fourZeros = false;
-                    break;
-                }
-            }
+struct B8zsScrambling
+{
+    static const char *suffix() { return " with B8ZS"; }
 
-            if (fourZeros)
-            {
-                if (pulseCount % 2 == 0)
-                {
-                    signal[i] = lastPulse;
-                    signal[i + 3] = lastPulse;
-                }
-                else
-                {
-                    signal[i + 3] = -lastPulse;
-                }
-                lastPulse = signal[i + 3];
-                pulseCount++;
-                i += 3;
-            }
-            else if (signal[i] != 0)
-            {
-                lastPulse = signal[i];
-                pulseCount++;
-            }
-        }
-        return signal;
+    template <class Code>
+    static void encode(const BitStream &data, int8_t *out)
+    {
+        static_assert(is_same<Code, AmiCode>::value, "B8ZS substitutes zero runs of an AMI signal");
+        LineEncoder::encodeAMIB8ZSInto(data, out);
+    }
+
+    template <class Code>
+    static void decode(const int8_t *signal, size_t numBits, char *out)
+    {
+        LineDecoder::decodeB8ZSInto(signal, numBits, out);
     }
 };
 
-// ==================== MODULATION SCHEMES ====================
+struct Hdb3Scrambling
+{
+    static const char *suffix() { return " with HDB3"; }
 
-class Modulator
+    template <class Code>
+    static void encode(const BitStream &data, int8_t *out)
+    {
+        static_assert(is_same<Code, AmiCode>::value, "HDB3 substitutes zero runs of an AMI signal");
+        LineEncoder::encodeAMIHDB3Into(data, out);
+    }
+
+    template <class Code>
+    static void decode(const int8_t *signal, size_t numBits, char *out)
+    {
+        LineDecoder::decodeHDB3Into(signal, numBits, out);
+    }
+};
+
+template <class Code, class Scrambling = NoScrambling>
+class LinePipeline
 {
 public:
-    static string encodePCM(const vector<double> &analogSignal, int bits = 8)
+    static string name()
     {
-        int levels = pow(2, bits);
-        double minVal = *min_element(analogSignal.begin(), analogSignal.end());
-        double maxVal = *max_element(analogSignal.begin(), analogSignal.end());
-        double step = (maxVal - minVal) / levels;
-
-        string digitalData = "";
-        for (double sample : analogSignal)
-        {
-            int quantized = (int)((sample - minVal) / step);
-            if (quantized >= levels)
-                quantized = levels - 1;
+        return string(Code::name()) + Scrambling::suffix();
+    }
 
-            for (int i = bits - 1; i >= 0; i--)
-            {
-                digitalData += ((quantized >> i) & 1) ? '1' : '0';
-            }
-        }
-        return digitalData;
+    static Signal encode(const BitStream &data)
+    {
+        Signal signal(Code::samplesPerBit * data.size());
+        Scrambling::template encode<Code>(data, signal.data());
+        return signal;
     }
 
-    static string encodeDM(const vector<double> &analogSignal, double delta = 0.5)
+    static string decode(const Signal &signal)
     {
-        string digitalData = "";
-        double approximation = analogSignal[0];
+        string data(signal.size() / Code::samplesPerBit, '0');
+        Scrambling::template decode<Code>(signal.data(), data.size(), &data[0]);
+        return data;
+    }
 
-        for (size_t i = 1; i < analogSignal.size(); i++)
+    // Samples outside the code's level alphabet, e.g. misread from an image.
+    static size_t countInvalidLevels(const Signal &signal)
+    {
+        size_t invalid = 0;
+        for (int8_t level : signal)
         {
-            if (analogSignal[i] > approximation)
-            {
-                digitalData += '1';
-                approximation += delta;
-            }
-            else
-            {
-                digitalData += '0';
-                approximation -= delta;
-            }
+            invalid += !Code::isLevel(level);
         }
-        return digitalData;
+        return invalid;
     }
 };
 
-// ==================== DECODER ====================
-
-class LineDecoder
+// A block code carried by a line code. Data is padded to whole blocks, so it decodes
+// to a multiple of the block size.
+template <class Block, class Code>
+class BlockLinePipeline
 {
 public:
-    static string decodeNRZL(const vector<int> &signal)
+    static string name()
     {
-        string data = "";
-        for (int level : signal)
-        {
-            data += (level > 0) ? '1' : '0';
-        }
-        return data;
+        return string(Block::name()) + " over " + Code::name();
     }
 
-    static string decodeNRZI(const vector<int> &signal)
+    static Signal encode(const BitStream &data)
     {
-        if (signal.empty())
-            return "";
-
-        string data = "";
-        int prevLevel = -1;
-
-        for (size_t i = 0; i < signal.size(); i++)
-        {
-            if (signal[i] != prevLevel)
-            {
-                data += '1';
-            }
-            else
-            {
-                data += '0';
-            }
-            prevLevel = signal[i];
-        }
-        return data;
+        return LineEncoder::encodeBlockCoded<Block, Code>(data);
     }
 
-    static string decodeManchester(const vector<int> &signal)
+    static string decode(const Signal &signal)
     {
-        string data = "";
-        for (size_t i = 0; i < signal.size(); i += 2)
-        {
-            if (i + 1 < signal.size())
-            {
-                if (signal[i] == -1 && signal[i + 1] == 1)
-                {
-                    data += '1';
-                }
-                else
-                {
-                    data += '0';
-                }
-            }
-        }
-        return data;
+        size_t invalidGroups;
+        return LineDecoder::decodeBlockCoded<Block>(signal, Code::scheme, invalidGroups).toString();
     }
 
-    static string decodeDifferentialManchester(const vector<int> &signal)
+    static size_t countInvalidLevels(const Signal &signal)
     {
-        if (signal.size() < 2)
-            return "";
-
-        string data = "";
-        int prevEndLevel = 1;
+        return LinePipeline<Code>::countInvalidLevels(signal);
+    }
+};
 
-        for (size_t i = 0; i < signal.size(); i += 2)
-        {
-            if (i + 1 < signal.size())
-            {
-                int currentStartLevel = signal[i];
+// Type-erased handle on one pipeline instantiation, for choosing a code at runtime.
+struct LineCodeEntry
+{
+    string name;
+    Signal (*encode)(const BitStream &data);
+    string (*decode)(const Signal &signal);
+    size_t (*countInvalidLevels)(const Signal &signal);
+};
 
-                if (currentStartLevel != prevEndLevel)
-                {
-                    data += '0';
-                }
-                else
-                {
-                    data += '1';
-                }
+template <class Pipeline>
+LineCodeEntry makeLineCodeEntry()
+{
+    LineCodeEntry entry = {Pipeline::name(), &Pipeline::encode, &Pipeline::decode, &Pipeline::countInvalidLevels};
+    return entry;
+}
 
-                prevEndLevel = signal[i + 1];
-            }
-        }
-        return data;
+class LineCodeRegistry
+{
+public:
+    static const vector<LineCodeEntry> &entries()
+    {
+        static const vector<LineCodeEntry> registry = {
+            makeLineCodeEntry<LinePipeline<NrzlCode>>(),
+            makeLineCodeEntry<LinePipeline<NrziCode>>(),
+            makeLineCodeEntry<LinePipeline<ManchesterCode>>(),
+            makeLineCodeEntry<LinePipeline<DifferentialManchesterCode>>(),
+            makeLineCodeEntry<LinePipeline<AmiCode>>(),
+            makeLineCodeEntry<LinePipeline<AmiCode, B8zsScrambling>>(),
+            makeLineCodeEntry<LinePipeline<AmiCode, Hdb3Scrambling>>(),
+            makeLineCodeEntry<LinePipeline<Mlt3Code>>(),
+            makeLineCodeEntry<BlockLinePipeline<Block4B5B, NrziCode>>(),
+            makeLineCodeEntry<BlockLinePipeline<Block4B5B, Mlt3Code>>(),
+            makeLineCodeEntry<BlockLinePipeline<Block8B10B, NrzlCode>>(),
+            makeLineCodeEntry<BlockLinePipeline<Block64B66B, NrzlCode>>(),
+        };
+        return registry;
     }
 
-    static string decodeAMI(const vector<int> &signal)
+    static const LineCodeEntry *find(const string &name)
     {
-        string data = "";
-        for (int level : signal)
+        for (const LineCodeEntry &entry : entries())
         {
-            data += (level == 0) ? '0' : '1';
+            if (entry.name == name)
+                return &entry;
         }
-        return data;
+        return nullptr;
     }
 };
 
@@ -400,9 +5092,9 @@ public:
 class ImageDecoder
 {
 public:
-    static vector<int> analyzeSignalImage(const string &imagePath)
+    static Signal analyzeSignalImage(const string &imagePath)
     {
-        vector<int> signal;
+        Signal signal;
 
         int width, height, channels;
         unsigned char *imageData = stbi_load(imagePath.c_str(), &width, &height, &channels, 0);
@@ -571,7 +5263,7 @@ public:
     }
 };
 
-void saveSignalToFile(const vector<int> &signal, const string &filename, const string &title, const string &data = "")
+void saveSignalToFile(const Signal &signal, const string &filename, const string &title, const string &data = "")
 {
     ofstream file(filename);
     file << "# " << title << "\n";
@@ -582,13 +5274,13 @@ void saveSignalToFile(const vector<int> &signal, const string &filename, const s
     file << "# Time, Signal\n";
     for (size_t i = 0; i < signal.size(); i++)
     {
-        file << i << "," << signal[i] << "\n";
+        file << i << "," << (int)signal[i] << "\n";
     }
     file.close();
     cout << "Signal data saved to " << filename << "\n";
 }
 
-void printEnhancedASCII(const vector<int> &signal, const string &data)
+void printEnhancedASCII(const Signal &signal, const string &data)
 {
     cout << "\n";
     cout << "========================================================\n";
@@ -675,16 +5367,16 @@ bool checkGnuplotInstalled()
     int result = system("gnuplot --version >nul 2>&1");
     return (result == 0);
 }
-void createGnuplotScript(const vector<int> &signal, const string &data, const string &encoding)
+void createGnuplotScript(const Signal &signal, const string &data, const string &encoding)
 {
     ofstream dataFile("plot_data.txt");
     dataFile << "# Original samples: " << signal.size() << "\n"; // <-- ADD THIS LINE
     for (size_t i = 0; i < signal.size(); i++)
     {
-        dataFile << i << " " << signal[i] << "\n";
+        dataFile << i << " " << (int)signal[i] << "\n";
     }
     // Add one extra point to complete the last step
-    dataFile << signal.size() << " " << signal.back() << "\n";
+    dataFile << signal.size() << " " << (int)signal.back() << "\n";
     dataFile.close();
 
     ofstream scriptFile("plot_signal.gnu");
@@ -759,6 +5451,85 @@ void generatePlot()
     }
 }
 
+// Analog input for main(): typed in, or synthesized by one of the built-in sources.
+vector<double> readAnalogSignal(size_t numSamples)
+{
+    int sourceType;
+    cout << "Select analog source:\n";
+    cout << "1. Enter values manually\n";
+    cout << "2. Sine\n";
+    cout << "3. Multi-tone\n";
+    cout << "4. Square\n";
+    cout << "5. Chirp\n";
+    cout << "6. Ramp\n";
+    cout << "7. Gaussian noise\n";
+    cout << "8. Uniform noise\n";
+    cout << "Enter choice: ";
+    cin >> sourceType;
+
+    vector<double> analogSignal(numSamples);
+    double frequency = 0, amplitude = 1.0;
+    if (sourceType == 2 || sourceType == 4 || sourceType == 6)
+    {
+        cout << "Enter frequency (cycles per sample) and amplitude: ";
+        cin >> frequency >> amplitude;
+    }
+
+    switch (sourceType)
+    {
+    case 2:
+        SineSource(frequency, amplitude).fill(analogSignal.data(), numSamples);
+        break;
+    case 3:
+    {
+        int numTones;
+        cout << "Enter number of tones: ";
+        cin >> numTones;
+        vector<Tone> tones;
+        for (int i = 0; i < numTones; i++)
+        {
+            Tone tone = {0, 0, 0};
+            cout << "Tone " << i + 1 << " frequency and amplitude: ";
+            cin >> tone.frequency >> tone.amplitude;
+            tones.push_back(tone);
+        }
+        MultiToneSource(tones).fill(analogSignal.data(), numSamples);
+        break;
+    }
+    case 4:
+        SquareSource(frequency, amplitude).fill(analogSignal.data(), numSamples);
+        break;
+    case 5:
+    {
+        double startFrequency, endFrequency;
+        cout << "Enter start and end frequency (cycles per sample): ";
+        cin >> startFrequency >> endFrequency;
+        ChirpSource(startFrequency, endFrequency, max((size_t)1, numSamples)).fill(analogSignal.data(), numSamples);
+        break;
+    }
+    case 6:
+        RampSource(frequency, amplitude).fill(analogSignal.data(), numSamples);
+        break;
+    case 7:
+        cout << "Enter standard deviation: ";
+        cin >> amplitude;
+        GaussianNoiseSource(amplitude).fill(analogSignal.data(), numSamples);
+        break;
+    case 8:
+        cout << "Enter amplitude: ";
+        cin >> amplitude;
+        UniformNoiseSource(amplitude).fill(analogSignal.data(), numSamples);
+        break;
+    default:
+        cout << "Enter " << numSamples << " analog values:\n";
+        for (size_t i = 0; i < numSamples; i++)
+        {
+            cin >> analogSignal[i];
+        }
+    }
+    return analogSignal;
+}
+
 // ==================== MAIN PROGRAM ====================
 
 int main()
@@ -794,29 +5565,38 @@ int main()
         cout << "Enter number of analog samples: ";
         cin >> numSamples;
 
-        vector<double> analogSignal(numSamples);
-        cout << "Enter " << numSamples << " analog values:\n";
-        for (int i = 0; i < numSamples; i++)
-        {
-            cin >> analogSignal[i];
-        }
+        vector<double> analogSignal = readAnalogSignal(max(0, numSamples));
+        ReconstructionReport report = {0, 0, 0, 0, 0};
 
         if (modulationType == 1)
         {
             int bits;
             cout << "Enter number of bits for quantization (default 8): ";
             cin >> bits;
-            digitalData = Modulator::encodePCM(analogSignal, bits);
+            if (!Modulator::validPCMBits(bits))
+            {
+                cout << "Error: Number of bits must be between 1 and 32.\n";
+                return 1;
+            }
+            // The codewords follow the header, exactly as encodePCM would emit them.
+            BitStream pcmBits = Modulator::encodePCMWithHeader(analogSignal, bits);
+            digitalData = pcmBits.toString().substr(PcmHeader::headerBits);
+            Modulator::decodePCM(pcmBits, analogSignal, report);
         }
         else
         {
             double delta;
             cout << "Enter delta value (default 0.5): ";
             cin >> delta;
-            digitalData = Modulator::encodeDM(analogSignal, delta);
+            BitStream deltaBits = Modulator::encodeDM(analogSignal, delta);
+            digitalData = deltaBits.toString();
+            Modulator::decodeDM(deltaBits, analogSignal, report, delta);
         }
 
         cout << "\nDigital Data Generated: " << digitalData << "\n";
+        if (report.samples > 0)
+            cout << "Reconstruction SNR: " << fixed << setprecision(2) << report.snrDb
+                 << " dB (ideal SQNR " << report.sqnrDb << " dB)\n";
     }
     else
     {
@@ -833,80 +5613,35 @@ int main()
         }
     }
 
+    BitStream digitalBits = BitStream::fromString(digitalData);
+
     string palindrome = findLongestPalindrome(digitalData);
     cout << "\n========================================================\n";
     cout << "  Longest Palindrome: " << palindrome << "\n";
     cout << "  Length: " << palindrome.length() << "\n";
     cout << "========================================================\n";
 
+    const vector<LineCodeEntry> &lineCodes = LineCodeRegistry::entries();
     cout << "\nSelect Line Encoding Scheme:\n";
-    cout << "1. NRZ-L\n";
-    cout << "2. NRZ-I\n";
-    cout << "3. Manchester\n";
-    cout << "4. Differential Manchester\n";
-    cout << "5. AMI (with optional scrambling)\n";
+    for (size_t i = 0; i < lineCodes.size(); i++)
+    {
+        cout << i + 1 << ". " << lineCodes[i].name << "\n";
+    }
     cout << "Enter choice: ";
 
-    int encodingChoice;
+    size_t encodingChoice = 0;
     cin >> encodingChoice;
 
-    vector<int> encodedSignal;
-    string encodingName;
-
-    switch (encodingChoice)
-    {
-    case 1:
-        encodedSignal = LineEncoder::encodeNRZL(digitalData);
-        encodingName = "NRZ-L";
-        break;
-    case 2:
-        encodedSignal = LineEncoder::encodeNRZI(digitalData);
-        encodingName = "NRZ-I";
-        break;
-    case 3:
-        encodedSignal = LineEncoder::encodeManchester(digitalData);
-        encodingName = "Manchester";
-        break;
-    case 4:
-        encodedSignal = LineEncoder::encodeDifferentialManchester(digitalData);
-        encodingName = "Differential Manchester";
-        break;
-    case 5:
+    if (encodingChoice < 1 || encodingChoice > lineCodes.size())
     {
-        encodedSignal = LineEncoder::encodeAMI(digitalData);
-        encodingName = "AMI";
-
-        char scramble;
-        cout << "Do you want scrambling? (y/n): ";
-        cin >> scramble;
-
-        if (scramble == 'y' || scramble == 'Y')
-        {
-            int scramblingType;
-            cout << "Select Scrambling Type:\n";
-            cout << "1. B8ZS\n";
-            cout << "2. HDB3\n";
-            cout << "Enter choice: ";
-            cin >> scramblingType;
-
-            if (scramblingType == 1)
-            {
-                encodedSignal = LineEncoder::scrambleB8ZS(encodedSignal);
-                encodingName = "AMI with B8ZS";
-            }
-            else
-            {
-                encodedSignal = LineEncoder::scrambleHDB3(encodedSignal);
-                encodingName = "AMI with HDB3";
-            }
-        }
-        break;
-    }
-    default:
         cout << "Invalid choice!\n";
         return 1;
     }
 
+    const LineCodeEntry *lineCode = &lineCodes[encodingChoice - 1];
+    const string &encodingName = lineCode->name;
+    Signal encodedSignal = lineCode->encode(digitalBits);
+
     cout << "\n========================================================\n";
     cout << "              ENCODING RESULTS                          \n";
     cout << "========================================================\n";
@@ -951,7 +5686,7 @@ int main()
         int decodeChoice;
         cin >> decodeChoice;
 
-        vector<int> readSignal;
+        Signal readSignal;
 
         if (decodeChoice == 2)
         {
@@ -966,12 +5701,12 @@ int main()
             {
                 checkFile.close();
 
-                vector<int> imageSignal = ImageDecoder::analyzeSignalImage("signal_plot.png");
+                Signal imageSignal = ImageDecoder::analyzeSignalImage("signal_plot.png");
 
                 if (!imageSignal.empty())
                 {
                     ifstream plotData("plot_data.txt");
-                    vector<int> correctSignal;
+                    Signal correctSignal;
                     string line;
                     while (getline(plotData, line))
                     {
@@ -1047,30 +5782,18 @@ int main()
         {
             string decodedData;
 
-            switch (encodingChoice)
+            size_t invalidLevels = lineCode->countInvalidLevels(readSignal);
+            if (invalidLevels > 0)
             {
-            case 1:
-                cout << "Decoding using: NRZ-L Decoder\n";
-                decodedData = LineDecoder::decodeNRZL(readSignal);
-                break;
-            case 2:
-                cout << "Decoding using: NRZ-I Decoder\n";
-                decodedData = LineDecoder::decodeNRZI(readSignal);
-                break;
-            case 3:
-                cout << "Decoding using: Manchester Decoder\n";
-                decodedData = LineDecoder::decodeManchester(readSignal);
-                break;
-            case 4:
-                cout << "Decoding using: Differential Manchester Decoder\n";
-                decodedData = LineDecoder::decodeDifferentialManchester(readSignal);
-                break;
-            case 5:
-                cout << "Decoding using: AMI Decoder\n";
-                decodedData = LineDecoder::decodeAMI(readSignal);
-                break;
+                cout << "[WARNING] " << invalidLevels << " samples are not valid " << lineCode->name << " levels\n";
             }
 
+            cout << "Decoding using: " << lineCode->name << " Decoder\n";
+            decodedData = lineCode->decode(readSignal);
+            // Block codes pad the data to whole blocks.
+            if (decodedData.size() > digitalData.size())
+                decodedData.resize(digitalData.size());
+
             cout << "\n========================================================\n";
             cout << "              DECODING RESULTS                          \n";
             cout << "========================================================\n";
@@ -0,0 +1,845 @@
+// ==================== SIGNAL GENERATOR TESTS ====================
+// Build and run next to new_signal_generator.cpp:
+//   g++ signal_tests.cpp -o signal_tests -std=c++14 -pthread && ./signal_tests
+#include <cassert>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#define main signalGeneratorMain
+#include "new_signal_generator.cpp"
+#undef main
+
+// Sparse random data, so that runs of eight and more zeros are common.
+BitStream sparseBits(size_t n, uint64_t seed)
+{
+    BitStream data;
+    for (size_t i = 0; i < n; i++)
+    {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        data.pushBit((seed >> 61) == 0);
+    }
+    return data;
+}
+
+BitStream sliceBits(const BitStream &bits, size_t pos, size_t count)
+{
+    BitStream slice;
+    for (size_t i = 0; i < count; i++)
+    {
+        slice.pushBit(bits.get(pos + i));
+    }
+    return slice;
+}
+
+// Calls chunk(pos, count) over n items in chunks of 1, 4, 13, 40, ... so that chunk
+// boundaries land at odd offsets, inside words and across them.
+template <class Chunk>
+void forEachChunk(size_t n, Chunk chunk)
+{
+    for (size_t pos = 0, size = 1; pos < n; pos += size, size = size * 3 % 97 + 1)
+    {
+        chunk(pos, min(size, n - pos));
+    }
+}
+
+// Runs a test on the vector kernels, then again on the scalar fallbacks that builds
+// without a vector unit use.
+template <class Test>
+void onEveryKernelPath(Test test)
+{
+    for (bool scalar : {false, true})
+    {
+        LevelKernels::forceScalar(scalar);
+        test();
+    }
+    LevelKernels::forceScalar(false);
+}
+
+// Feeds data to a streaming encoder in odd-sized chunks and returns all it emits.
+template <class Encoder>
+Signal encodeChunked(Encoder &encoder, const BitStream &data)
+{
+    Signal signal;
+    forEachChunk(data.size(), [&](size_t pos, size_t count)
+    {
+        Signal part = encoder.push(sliceBits(data, pos, count));
+        signal.insert(signal.end(), part.begin(), part.end());
+    });
+    Signal rest = encoder.flush();
+    signal.insert(signal.end(), rest.begin(), rest.end());
+    return signal;
+}
+
+// Sparse data puts substituted runs across many chunk boundaries.
+void testStreamingEncoders()
+{
+    NrziEncoder nrzi;
+    DifferentialManchesterEncoder differentialManchester;
+    AmiEncoder ami;
+    B8zsEncoder b8zs;
+    Hdb3Encoder hdb3;
+    for (size_t n : {1, 8, 9, 64, 200, 5000})
+    {
+        BitStream data = sparseBits(n, n + 5);
+        Signal marks = LineEncoder::encodeAMI(data);
+        // Twice, to check flush() readies the encoder for the next stream.
+        for (int pass = 0; pass < 2; pass++)
+        {
+            assert(encodeChunked(nrzi, data) == LineEncoder::encodeNRZI(data));
+            assert(encodeChunked(differentialManchester, data) == LineEncoder::encodeDifferentialManchester(data));
+            assert(encodeChunked(ami, data) == marks);
+            assert(encodeChunked(b8zs, data) == LineEncoder::scrambleB8ZS(marks));
+            assert(encodeChunked(hdb3, data) == LineEncoder::scrambleHDB3(marks));
+        }
+    }
+}
+
+// Chunks are at least 1024 words, so these lengths give one, three and seven chunks with
+// the last one ragged.
+void testParallelEncode()
+{
+    struct ParallelCase
+    {
+        LineCodeScheme scheme;
+        Signal (*serial)(const BitStream &);
+    };
+    const ParallelCase cases[] = {{LineCodeScheme::NRZL, LineEncoder::encodeNRZL},
+                                  {LineCodeScheme::NRZI, LineEncoder::encodeNRZI},
+                                  {LineCodeScheme::Manchester, LineEncoder::encodeManchester},
+                                  {LineCodeScheme::DifferentialManchester, LineEncoder::encodeDifferentialManchester},
+                                  {LineCodeScheme::MLT3, LineEncoder::encodeMLT3},
+                                  {LineCodeScheme::AMI, LineEncoder::encodeAMI}};
+    ThreadPool pool(6);
+    for (size_t n : {1000, 3 * 1024 * 64 + 1, 7 * 1024 * 64 + 37})
+    {
+        BitStream data = sparseBits(n, n);
+        for (size_t i = 0; i < n; i += 5)
+        {
+            data.set(i, !data.get(i));
+        }
+        for (const ParallelCase &c : cases)
+        {
+            assert(LineEncoder::encodeParallel(data, c.scheme, pool) == c.serial(data));
+        }
+    }
+
+    // A throwing task still lets the run finish, reaches the caller, and leaves the pool usable.
+    for (int round = 0; round < 20; round++)
+    {
+        vector<int> ran(64, 0);
+        bool threw = false;
+        try
+        {
+            pool.run(ran.size(), [&](size_t i)
+                     {
+                         ran[i] = 1;
+                         if (i % 7 == 3)
+                             throw runtime_error("task failed");
+                     });
+        }
+        catch (const runtime_error &)
+        {
+            threw = true;
+        }
+        assert(threw);
+        assert(count(ran.begin(), ran.end(), 1) == (int)ran.size());
+    }
+    BitStream data = sparseBits(100000, 3);
+    assert(LineEncoder::encodeParallel(data, LineCodeScheme::AMI, pool) == LineEncoder::encodeAMI(data));
+}
+
+// Longer than one 4096-sample kernel block plus its lookahead word.
+void testLongScrambledCaptures()
+{
+    for (size_t n : {4159, 4160, 4161, 4224, 4225, 20000})
+    {
+        BitStream data = sparseBits(n, n);
+        string expected = data.toString();
+
+        Signal b8zs = LineEncoder::encodeAMIB8ZS(data);
+        assert(LineDecoder::decodeB8ZS(b8zs) == expected);
+        assert(LineDecoder::descrambleB8ZS(b8zs) == LineEncoder::encodeAMI(data));
+
+        Signal hdb3 = LineEncoder::encodeAMIHDB3(data);
+        assert(LineDecoder::decodeHDB3(hdb3) == expected);
+        assert(LineDecoder::descrambleHDB3(hdb3) == LineEncoder::encodeAMI(data));
+    }
+}
+
+// Odd chunk sizes split Manchester pairs; the output must match the one-shot decoders.
+template <class Decoder>
+void checkStreamingDecoder(Decoder &decoder, LineCodeScheme scheme, const BitStream &data)
+{
+    Signal signal;
+    LineEncoder::encodeInto(data, scheme, signal);
+    BitStream out;
+    forEachChunk(signal.size(), [&](size_t pos, size_t count)
+    {
+        decoder.push(signal.data() + pos, count, out);
+    });
+    decoder.flush();
+    assert(out.toString() == LineDecoder::decodePacked(signal, scheme).toString());
+    assert(out.toString() == data.toString());
+}
+
+void testStreamingDecoders()
+{
+    NrzlDecoder nrzl;
+    NrziDecoder nrzi;
+    ManchesterDecoder manchester;
+    DifferentialManchesterDecoder differentialManchester;
+    AmiDecoder ami;
+    Mlt3Decoder mlt3;
+    for (size_t n : {1, 64, 200, 5000})
+    {
+        BitStream data = sparseBits(n, n + 13);
+        for (int pass = 0; pass < 2; pass++)
+        {
+            checkStreamingDecoder(nrzl, LineCodeScheme::NRZL, data);
+            checkStreamingDecoder(nrzi, LineCodeScheme::NRZI, data);
+            checkStreamingDecoder(manchester, LineCodeScheme::Manchester, data);
+            checkStreamingDecoder(differentialManchester, LineCodeScheme::DifferentialManchester, data);
+            checkStreamingDecoder(ami, LineCodeScheme::AMI, data);
+            checkStreamingDecoder(mlt3, LineCodeScheme::MLT3, data);
+        }
+    }
+}
+
+void testPCMWidths()
+{
+    vector<double> samples = {0.0, 0.25, -0.5, 1.0};
+    assert(Modulator::encodePCM(samples, 0).size() == 0);
+    assert(Modulator::encodePCM(samples, 33).size() == 0);
+    assert(Modulator::encodePCMWithHeader(samples, 0).size() == 0);
+
+    BitStream wide = Modulator::encodePCMWithHeader(samples, 32);
+    vector<double> decoded = Modulator::decodePCM(wide);
+    assert(decoded.size() == samples.size());
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+        assert(fabs(decoded[i] - samples[i]) < 1e-9);
+    }
+}
+
+void testSigmaDeltaOrders()
+{
+    vector<double> tone = SineSource(0.0005, 0.5).generate(1 << 16);
+    SigmaDeltaFormat second, third;
+    third.order = 3;
+    BitStream bits = Modulator::encodeSigmaDelta(tone, second);
+    assert(Modulator::encodeSigmaDelta(tone, third).toString() == bits.toString());
+    assert(Modulator::decodeSigmaDelta(bits, third) == Modulator::decodeSigmaDelta(bits, second));
+
+    // Long enough for the CIC integrators to wrap.
+    vector<double> level(13000000, 0.5);
+    vector<double> decoded = Modulator::decodeSigmaDelta(Modulator::encodeSigmaDelta(level, second), second);
+    for (size_t i = 4; i < decoded.size(); i++)
+    {
+        assert(fabs(decoded[i] - 0.5) < 0.05);
+    }
+
+    SigmaDeltaFormat undecimated;
+    undecimated.decimation = 0;
+    bool threw = false;
+    try
+    {
+        SigmaDeltaDecoder decoder(undecimated);
+    }
+    catch (const invalid_argument &)
+    {
+        threw = true;
+    }
+    assert(threw);
+}
+
+void testADPCMChannels()
+{
+    vector<vector<double>> channels(3, SineSource(0.01, 0.5).generate(1000));
+    BitStream bits = Modulator::encodeADPCM(channels);
+    assert(Modulator::decodeADPCM(bits, 0).empty());
+    assert(Modulator::decodeADPCM(bits, 3).size() == 3);
+}
+
+// Eleven channels fill one eight-lane AVX2 group and leave a scalar tail; both
+// kernel paths must decode them identically and track the input closely.
+void testADPCMLanes()
+{
+    vector<vector<double>> channels;
+    for (int c = 0; c < 11; c++)
+    {
+        channels.push_back(SineSource(0.002 * (c + 1), 0.25 + 0.05 * c, 0.3 * c).generate(2000));
+    }
+    BitStream bits = Modulator::encodeADPCM(channels);
+    vector<vector<vector<double>>> decoded;
+    onEveryKernelPath([&]()
+                      { decoded.push_back(Modulator::decodeADPCM(bits, channels.size())); });
+    assert(decoded[0] == decoded[1]);
+
+    // Skip the first frames while the step size adapts up from its initial value.
+    double worst = 0;
+    for (size_t c = 0; c < channels.size(); c++)
+    {
+        for (size_t f = 100; f < channels[c].size(); f++)
+        {
+            worst = max(worst, fabs(decoded[0][c][f] - channels[c][f]));
+        }
+    }
+    assert(worst < 0.02);
+}
+
+void testSquareDuty()
+{
+    for (double sample : SquareSource(0.01, 1.0, 1.0).generate(500))
+    {
+        assert(sample == 1.0);
+    }
+    for (double sample : SquareSource(0.01, 1.0, 0.0).generate(500))
+    {
+        assert(sample == -1.0);
+    }
+    for (double sample : SquareSource(0.01, 1.0, -0.25).generate(500))
+    {
+        assert(sample == -1.0);
+    }
+}
+
+void testChirpSweepLength()
+{
+    bool threw = false;
+    try
+    {
+        ChirpSource(0.01, 0.1, 0);
+    }
+    catch (const invalid_argument &)
+    {
+        threw = true;
+    }
+    assert(threw);
+    assert(ChirpSource(0.01, 0.1, 1).generate(10).size() == 10);
+}
+
+// Raised cosine pulses cross zero at every other symbol instant, odd samplesPerSymbol included.
+void testPulseShaperZeroISI()
+{
+    Signal levels = LineEncoder::encodeAMI(sparseBits(2000, 7));
+    for (int samplesPerSymbol : {3, 4, 5, 9})
+    {
+        PulseFormat format;
+        format.samplesPerSymbol = samplesPerSymbol;
+        format.spanSymbols = 16;
+        vector<float> waveform = PulseShaper::shape(levels, format);
+        for (size_t i = 0; i < levels.size(); i++)
+        {
+            assert(fabs(waveform[i * samplesPerSymbol] - levels[i]) < 1e-5);
+        }
+
+        format.shape = PulseShape::Rectangular;
+        waveform = PulseShaper::shape(levels, format);
+        for (size_t i = 0; i < waveform.size(); i++)
+        {
+            assert(waveform[i] == levels[i / samplesPerSymbol]);
+        }
+    }
+
+    for (int samplesPerSymbol : {0, -1})
+    {
+        PulseFormat format;
+        format.samplesPerSymbol = samplesPerSymbol;
+        bool threw = false;
+        try
+        {
+            PulseShaper shaper(format);
+        }
+        catch (const invalid_argument &)
+        {
+            threw = true;
+        }
+        assert(threw);
+    }
+}
+
+// The report is built alongside the reconstruction; check it against a separate pass.
+void testDeltaModulationReport()
+{
+    vector<double> empty;
+    ReconstructionReport emptyReport;
+    assert(Modulator::encodeDM(empty).empty());
+    Modulator::decodeDM(Modulator::encodeDM(empty), empty, emptyReport);
+    assert(emptyReport.samples == 0 && emptyReport.snrDb == 0 && emptyReport.sqnrDb == 0);
+
+    for (size_t n : {1, 2, 4097, 10000})
+    {
+        vector<double> tone = SineSource(0.003, 0.8).generate(n);
+        BitStream bits = Modulator::encodeDM(tone, 0.01);
+        for (int filterWindow : {1, 9})
+        {
+            ReconstructionReport report;
+            vector<double> decoded = Modulator::decodeDM(bits, tone, report, 0.01, filterWindow);
+            assert(decoded == Modulator::decodeDM(bits, 0.01, tone[0], filterWindow));
+            assert(report.samples == n);
+
+            double signalSum = 0, errorSum = 0;
+            for (size_t i = 0; i < n; i++)
+            {
+                signalSum += tone[i] * tone[i];
+                errorSum += (tone[i] - decoded[i]) * (tone[i] - decoded[i]);
+            }
+            assert(fabs(report.signalPower - signalSum / n) <= 1e-9 * (1 + signalSum / n));
+            assert(fabs(report.noisePower - errorSum / n) <= 1e-9 * (1 + errorSum / n));
+        }
+    }
+}
+
+// Every kernel again with the vector units switched off, checked against the vector
+// output and against a round trip.
+void testScalarKernels()
+{
+    const LineCodeScheme schemes[] = {LineCodeScheme::NRZL, LineCodeScheme::NRZI, LineCodeScheme::Manchester,
+                                      LineCodeScheme::DifferentialManchester, LineCodeScheme::AMI, LineCodeScheme::MLT3};
+    for (size_t n : {1, 63, 64, 65, 130, 4097, 9000})
+    {
+        BitStream data = sparseBits(n, n + 1);
+        string expected = data.toString();
+        for (LineCodeScheme scheme : schemes)
+        {
+            Signal vectorSignal;
+            LineEncoder::encodeInto(data, scheme, vectorSignal);
+            LevelKernels::forceScalar(true);
+            Signal signal;
+            LineEncoder::encodeInto(data, scheme, signal);
+            string decoded;
+            LineDecoder::decodeInto(signal, scheme, decoded);
+            BitStream packed = LineDecoder::decodePacked(signal, scheme);
+            LevelKernels::forceScalar(false);
+            assert(signal == vectorSignal);
+            assert(decoded == expected);
+            assert(packed.toString() == expected);
+        }
+
+        Signal vectorB8zs = LineEncoder::encodeAMIB8ZS(data);
+        Signal vectorHdb3 = LineEncoder::encodeAMIHDB3(data);
+        LevelKernels::forceScalar(true);
+        Signal b8zs = LineEncoder::encodeAMIB8ZS(data);
+        Signal hdb3 = LineEncoder::encodeAMIHDB3(data);
+        string b8zsDecoded = LineDecoder::decodeB8ZS(b8zs);
+        string hdb3Decoded = LineDecoder::decodeHDB3(hdb3);
+        LevelKernels::forceScalar(false);
+        assert(b8zs == vectorB8zs && hdb3 == vectorHdb3);
+        assert(b8zsDecoded == expected && hdb3Decoded == expected);
+    }
+}
+
+void testStreamingPcmFormats()
+{
+    PcmFormat format = {PcmRange::BlockFloatingPoint, 8, 1.0, 256};
+    PcmFormat bad[] = {format, format, format};
+    bad[0].bits = 0;
+    bad[1].bits = 32;
+    bad[2].blockSamples = 0;
+    for (const PcmFormat &f : bad)
+    {
+        bool encoderThrew = false, decoderThrew = false;
+        try
+        {
+            StreamingPcmEncoder encoder(f);
+        }
+        catch (const invalid_argument &)
+        {
+            encoderThrew = true;
+        }
+        try
+        {
+            StreamingPcmDecoder decoder(f);
+        }
+        catch (const invalid_argument &)
+        {
+            decoderThrew = true;
+        }
+        assert(encoderThrew && decoderThrew);
+    }
+
+    vector<double> tone = SineSource(0.01, 0.5).generate(1000);
+    StreamingPcmEncoder encoder(format);
+    StreamingPcmDecoder decoder(format);
+    BitStream bits = encoder.push(tone);
+    bits.append(encoder.flush());
+    vector<double> decoded = decoder.push(bits);
+    assert(decoded.size() == tone.size());
+    for (size_t i = 0; i < tone.size(); i++)
+    {
+        assert(fabs(decoded[i] - tone[i]) < 1.0 / 256);
+    }
+}
+
+void testDPCMWidths()
+{
+    vector<double> tone = SineSource(0.01, 0.5).generate(100);
+    for (int bits : {-1, 0, 1, 32})
+    {
+        bool encoderThrew = false, decoderThrew = false;
+        try
+        {
+            Modulator::encodeDPCM(tone, bits);
+        }
+        catch (const invalid_argument &)
+        {
+            encoderThrew = true;
+        }
+        try
+        {
+            Modulator::decodeDPCM(BitStream::fromString("0110"), bits);
+        }
+        catch (const invalid_argument &)
+        {
+            decoderThrew = true;
+        }
+        assert(encoderThrew && decoderThrew);
+    }
+    for (int bits : {2, 31})
+    {
+        assert(Modulator::decodeDPCM(Modulator::encodeDPCM(tone, bits), bits).size() == tone.size());
+    }
+
+    // Without slope overload every sample rounds to within half a step.
+    vector<double> decoded = Modulator::decodeDPCM(Modulator::encodeDPCM(tone));
+    for (size_t i = 0; i < tone.size(); i++)
+    {
+        assert(fabs(decoded[i] - tone[i]) <= 0.5 / 64 + 1e-12);
+    }
+}
+
+void testCVSDRunLengths()
+{
+    vector<double> tone = SineSource(0.002, 0.5).generate(5000);
+    CvsdFormat shortest, longest, zero, huge;
+    shortest.runLength = 1;
+    longest.runLength = 31;
+    zero.runLength = 0;
+    huge.runLength = 40;
+    assert(Modulator::encodeCVSD(tone, zero).toString() == Modulator::encodeCVSD(tone, shortest).toString());
+    assert(Modulator::encodeCVSD(tone, huge).toString() == Modulator::encodeCVSD(tone, longest).toString());
+}
+
+// Data comes back padded with zeros to whole blocks.
+template <class Block>
+void checkBlockRoundTrip(const BitStream &data)
+{
+    size_t invalidGroups = 1;
+    BitStream code = Block::encode(data);
+    size_t numBlocks = code.size() / Block::codeBits;
+    assert(code.size() == numBlocks * Block::codeBits);
+    assert(numBlocks * Block::dataBits >= data.size() && numBlocks * Block::dataBits < data.size() + Block::dataBits);
+
+    string decoded = Block::decode(code, invalidGroups).toString();
+    assert(invalidGroups == 0);
+    assert(decoded == data.toString() + string(decoded.size() - data.size(), '0'));
+}
+
+// Zeroes every third code group, which no block code uses for data (64b/66b: its sync header).
+template <class Block>
+void checkBlockInvalidGroups(const BitStream &data)
+{
+    BitStream code = Block::encode(data);
+    size_t numBlocks = code.size() / Block::codeBits, corrupted = 0;
+    for (size_t b = 0; b < numBlocks; b += 3)
+    {
+        size_t width = (Block::codeBits == 66) ? 2 : Block::codeBits;
+        for (size_t i = 0; i < width; i++)
+        {
+            code.set(b * Block::codeBits + i, false);
+        }
+        corrupted++;
+    }
+    size_t invalidGroups = 0;
+    BitStream decoded = Block::decode(code, invalidGroups);
+    assert(invalidGroups == corrupted);
+    for (size_t b = 0; b < numBlocks; b += 3)
+    {
+        assert(decoded.getBits(b * Block::dataBits, (int)Block::dataBits) == 0);
+    }
+}
+
+void testBlockCodes()
+{
+    for (size_t n : {1, 3, 5, 7, 9, 13, 63, 65, 100, 1001})
+    {
+        BitStream data = sparseBits(n, 3 * n);
+        for (size_t i = 0; i < n; i += 3)
+        {
+            data.set(i, !data.get(i));
+        }
+        checkBlockRoundTrip<Block4B5B>(data);
+        checkBlockRoundTrip<Block8B10B>(data);
+        checkBlockRoundTrip<Block64B66B>(data);
+
+        string expected = data.toString();
+        assert(LineDecoder::decode4B5B(LineEncoder::encode4B5B(data)).compare(0, n, expected) == 0);
+        assert(LineDecoder::decode4B5B(LineEncoder::encode4B5B(data, LineCodeScheme::MLT3), LineCodeScheme::MLT3).compare(0, n, expected) == 0);
+        assert(LineDecoder::decode8B10B(LineEncoder::encode8B10B(data)).compare(0, n, expected) == 0);
+        assert(LineDecoder::decode64B66B(LineEncoder::encode64B66B(data)).compare(0, n, expected) == 0);
+    }
+
+    // Every byte value, then random ones, from both starting disparities.
+    BitStream bytes;
+    for (unsigned b = 0; b < 256; b++)
+    {
+        bytes.appendBits(b, 8);
+    }
+    NoiseGenerator generator(11);
+    for (int i = 0; i < 4096; i++)
+    {
+        bytes.appendBits(generator.next(), 8);
+    }
+    for (bool start : {false, true})
+    {
+        bool positive = start;
+        BitStream code = Block8B10B::encode(bytes, positive);
+        int disparity = start ? 1 : -1;
+        for (size_t i = 0; i < code.size(); i++)
+        {
+            disparity += code.get(i) ? 1 : -1;
+            assert(disparity >= -3 && disparity <= 3);
+            if (i % 10 == 9)
+                assert(disparity == 1 || disparity == -1);
+        }
+        assert(positive == (disparity == 1));
+    }
+
+    BitStream data = sparseBits(6400, 5);
+    checkBlockInvalidGroups<Block4B5B>(data);
+    checkBlockInvalidGroups<Block8B10B>(data);
+    checkBlockInvalidGroups<Block64B66B>(data);
+}
+
+// One bit at a time: out[i] = in[i] ^ out[i - TapA] ^ out[i - TapB], from a zero history.
+string referenceScramble(const BitStream &data, int tapA, int tapB)
+{
+    string out(data.size(), '0');
+    for (size_t i = 0; i < data.size(); i++)
+    {
+        bool bit = data.get(i);
+        if (i >= (size_t)tapA)
+            bit ^= out[i - tapA] == '1';
+        if (tapB > 0 && i >= (size_t)tapB)
+            bit ^= out[i - tapB] == '1';
+        out[i] = bit ? '1' : '0';
+    }
+    return out;
+}
+
+template <class Scrambler>
+void checkScrambler(int tapA, int tapB)
+{
+    for (size_t n : {1, 40, 64, 65, 127, 1000, 5000})
+    {
+        BitStream data = sparseBits(n, n + 17);
+        BitStream scrambled = LineEncoder::scramble<Scrambler>(data);
+        assert(scrambled.toString() == referenceScramble(data, tapA, tapB));
+        assert(LineDecoder::descramble<Scrambler>(scrambled).toString() == data.toString());
+
+        // Chunks of odd sizes with the history carried across calls.
+        uint64_t scrambleHistory = 0, descrambleHistory = 0;
+        BitStream chunked, unscrambled;
+        forEachChunk(n, [&](size_t pos, size_t count)
+        {
+            chunked.append(LineEncoder::scramble<Scrambler>(sliceBits(data, pos, count), scrambleHistory));
+            unscrambled.append(LineDecoder::descramble<Scrambler>(sliceBits(scrambled, pos, count), descrambleHistory));
+        });
+        assert(chunked.toString() == scrambled.toString());
+        assert(unscrambled.toString() == data.toString());
+
+        // A corrupted prefix and a wrong starting history only cost the next tapA bits.
+        size_t prefix = min(n, (size_t)10);
+        BitStream damaged = scrambled;
+        for (size_t i = 0; i < prefix; i++)
+        {
+            damaged.set(i, !damaged.get(i));
+        }
+        uint64_t history = ~(uint64_t)0;
+        string recovered = LineDecoder::descramble<Scrambler>(damaged, history).toString();
+        string expected = data.toString();
+        if (n > prefix + tapA)
+            assert(recovered.compare(prefix + tapA, string::npos, expected, prefix + tapA, string::npos) == 0);
+    }
+}
+
+void testScramblers()
+{
+    checkScrambler<Scrambler7>(7, 4);
+    checkScrambler<Scrambler43>(43, 0);
+    checkScrambler<Scrambler58>(58, 39);
+}
+
+// The Sun Microsystems g711.c reference coders, which take 14-bit (mu-law) and 13-bit
+// (A-law) samples from the top of the 16-bit input.
+int g711Segment(int value, int firstEnd)
+{
+    int segment = 0;
+    while (segment < 8 && value > (firstEnd << segment | ((1 << segment) - 1)))
+    {
+        segment++;
+    }
+    return segment;
+}
+
+uint8_t referenceMuLaw(int16_t sample)
+{
+    int value = sample >> 2;
+    int mask = 0xFF;
+    if (value < 0)
+    {
+        value = -value;
+        mask = 0x7F;
+    }
+    value = min(value, 8159) + 0x21;
+    int segment = g711Segment(value, 0x3F);
+    if (segment >= 8)
+        return (uint8_t)(0x7F ^ mask);
+    return (uint8_t)(((segment << 4) | ((value >> (segment + 1)) & 0x0F)) ^ mask);
+}
+
+uint8_t referenceALaw(int16_t sample)
+{
+    int value = sample >> 3;
+    int mask = 0xD5;
+    if (value < 0)
+    {
+        value = -value - 1;
+        mask = 0x55;
+    }
+    int segment = g711Segment(value, 0x1F);
+    if (segment >= 8)
+        return (uint8_t)(0x7F ^ mask);
+    int code = segment << 4 | ((value >> (segment < 2 ? 1 : segment)) & 0x0F);
+    return (uint8_t)(code ^ mask);
+}
+
+int16_t referenceMuLawLinear(uint8_t code)
+{
+    int u = ~code & 0xFF;
+    int t = (((u & 0x0F) << 3) + 0x84) << ((u & 0x70) >> 4);
+    return (int16_t)((u & 0x80) ? 0x84 - t : t - 0x84);
+}
+
+int16_t referenceALawLinear(uint8_t code)
+{
+    int a = code ^ 0x55;
+    int t = (a & 0x0F) << 4;
+    int segment = (a & 0x70) >> 4;
+    if (segment == 0)
+        t += 8;
+    else
+        t = (t + 0x108) << (segment - 1);
+    return (int16_t)((a & 0x80) ? t : -t);
+}
+
+// Every 16-bit input through the vector and the scalar encoders, and every code back.
+void testCompanding()
+{
+    vector<int16_t> samples(65536);
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+        samples[i] = (int16_t)(i - 32768);
+    }
+    onEveryKernelPath([&]()
+    {
+        vector<uint8_t> muCodes(samples.size()), aCodes(samples.size());
+        Modulator::encodeMuLaw(samples.data(), samples.size(), muCodes.data());
+        Modulator::encodeALaw(samples.data(), samples.size(), aCodes.data());
+        for (size_t i = 0; i < samples.size(); i++)
+        {
+            assert(muCodes[i] == referenceMuLaw(samples[i]));
+            assert(aCodes[i] == referenceALaw(samples[i]));
+        }
+    });
+
+    uint8_t codes[256];
+    int16_t muLinear[256], aLinear[256];
+    for (unsigned code = 0; code < 256; code++)
+    {
+        codes[code] = (uint8_t)code;
+    }
+    Modulator::decodeMuLaw(codes, 256, muLinear);
+    Modulator::decodeALaw(codes, 256, aLinear);
+    for (unsigned code = 0; code < 256; code++)
+    {
+        assert(muLinear[code] == referenceMuLawLinear((uint8_t)code));
+        assert(aLinear[code] == referenceALawLinear((uint8_t)code));
+    }
+}
+
+// Noise-free, so every scheme must return the data exactly, padded to a whole symbol.
+void testPassbandRoundTrip()
+{
+    const PassbandScheme schemes[] = {PassbandScheme::ASK, PassbandScheme::FSK, PassbandScheme::BPSK,
+                                      PassbandScheme::QPSK, PassbandScheme::QAM16};
+    for (PassbandScheme scheme : schemes)
+    {
+        PassbandFormat format;
+        format.scheme = scheme;
+        int bitsPerSymbol = PassbandModulator::bitsPerSymbol(scheme);
+        for (size_t n : {1, 7, 64, 1001})
+        {
+            BitStream data = sparseBits(n, n + 21);
+            for (size_t i = 0; i < n; i += 3)
+            {
+                data.set(i, !data.get(i));
+            }
+            size_t numSymbols = (n + bitsPerSymbol - 1) / bitsPerSymbol;
+            vector<float> waveform = PassbandModulator::modulate(data, format);
+            assert(waveform.size() == numSymbols * format.samplesPerSymbol);
+
+            string decoded = PassbandModulator::demodulate(waveform, format).toString();
+            assert(decoded.size() == numSymbols * bitsPerSymbol);
+            assert(decoded == data.toString() + string(decoded.size() - n, '0'));
+        }
+    }
+
+    PassbandFormat empty;
+    empty.samplesPerSymbol = 0;
+    bool modulatorThrew = false, demodulatorThrew = false;
+    try
+    {
+        PassbandModulator::modulate(BitStream::fromString("0110"), empty);
+    }
+    catch (const invalid_argument &)
+    {
+        modulatorThrew = true;
+    }
+    try
+    {
+        PassbandModulator::demodulate(vector<float>(16), empty);
+    }
+    catch (const invalid_argument &)
+    {
+        demodulatorThrew = true;
+    }
+    assert(modulatorThrew && demodulatorThrew);
+}
+
+int main()
+{
+    onEveryKernelPath(testStreamingEncoders);
+    testParallelEncode();
+    testLongScrambledCaptures();
+    onEveryKernelPath(testStreamingDecoders);
+    testPCMWidths();
+    testSigmaDeltaOrders();
+    testADPCMChannels();
+    testADPCMLanes();
+    testSquareDuty();
+    testChirpSweepLength();
+    testPulseShaperZeroISI();
+    testDeltaModulationReport();
+    testScalarKernels();
+    testStreamingPcmFormats();
+    testDPCMWidths();
+    testCVSDRunLengths();
+    testBlockCodes();
+    testScramblers();
+    testCompanding();
+    testPassbandRoundTrip();
+    cout << "All tests passed\n";
+    return 0;
+}